@@ -0,0 +1,169 @@
+/*
+   usage: ./fakeydotoold [socketPath] [q]
+
+    socketPath: where to listen; defaults to $YDOTOOL_SOCKET, then /tmp/.ydotool_socket
+    q: quiet; only print the totals on exit instead of every event
+
+   Description:
+   a stand-in for ydotoold, for trying js2mouse's ydotool backend (make compile-ydotool)
+   without root or /dev/uinput. It listens on the same datagram socket, takes the same
+   one-struct-input_event-per-datagram stream, and prints what it would have injected.
+   On Ctrl-C it prints how far the pointer moved and how many events and reads it took,
+   which shows how well js2mouse batches.
+
+   Build with `make compile-fakeydotoold`, then:
+    ./fakeydotoold &
+    ./js2mouse
+*/
+
+#define _GNU_SOURCE //for recvmmsg()
+
+#include <stdlib.h> //for getenv()
+#include <stdio.h>
+#include <stdbool.h> //bool, true/false
+#include <string.h> //strcmp, strcpy
+#include <unistd.h> //for unlink()
+#include <signal.h> //for sigaction()
+#include <errno.h> //for errno and EINTR
+#include <sys/socket.h> //for the daemon socket
+#include <sys/un.h> //for struct sockaddr_un
+#include <linux/input.h> //for struct input_event and the EV_* constants
+
+#define DEFAULT_SOCKET "/tmp/.ydotool_socket" //ydotoold's default
+#define READ_BATCH 64 //datagrams taken per recvmmsg()
+
+volatile sig_atomic_t running = true;
+
+void stop(int signal);
+
+int main(int argc, char* argv[])
+{
+    const char* path = (NULL != getenv("YDOTOOL_SOCKET")) ? getenv("YDOTOOL_SOCKET") : DEFAULT_SOCKET;
+    bool quiet = false;
+    for(int i = 1; i < argc; i++)
+    {
+        if(0 == strcmp(argv[i], "q"))
+        {
+            quiet = true;
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+
+    struct sockaddr_un address = {0};
+    if(strlen(path) >= sizeof(address.sun_path))
+    {
+        printf("Error: socket path [%s] is too long\nExiting....", path);
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    unlink(path); //left behind by an earlier run
+    if(fd < 0 || 0 != bind(fd, (struct sockaddr*) &address, sizeof(address)))
+    {
+        printf("Error: failed to listen on [%s]\nExiting....", path);
+        return -1;
+    }
+
+    //no SA_RESTART, so Ctrl-C interrupts the blocking read below
+    struct sigaction action = {0};
+    action.sa_handler = stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    printf("Listening on [%s]. . .\n", path);
+    fflush(stdout);
+
+    struct input_event events[READ_BATCH];
+    struct iovec parts[READ_BATCH];
+    struct mmsghdr messages[READ_BATCH];
+    long total = 0;
+    long reads = 0;
+    long keys = 0;
+    long reports = 0;
+    long dx = 0;
+    long dy = 0;
+    while(running)
+    {
+        memset(messages, 0, sizeof(messages));
+        for(int i = 0; i < READ_BATCH; i++)
+        {
+            parts[i].iov_base = &events[i];
+            parts[i].iov_len = sizeof(struct input_event);
+            messages[i].msg_hdr.msg_iov = &parts[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        //block for the first datagram, then take whatever else is already waiting
+        int count = recvmmsg(fd, messages, READ_BATCH, MSG_WAITFORONE, NULL);
+        if(count < 0)
+        {
+            if(EINTR == errno)
+            {
+                continue;
+            }
+            printf("Error: read failed\n");
+            break;
+        }
+        reads++;
+
+        for(int i = 0; i < count; i++)
+        {
+            if(sizeof(struct input_event) != messages[i].msg_len)
+            {
+                printf("Warning: ignoring a %u byte datagram\n", messages[i].msg_len);
+                continue;
+            }
+            struct input_event* event = &events[i];
+            total++;
+            switch(event->type)
+            {
+                case EV_REL:
+                    if(REL_X == event->code)
+                    {
+                        dx += event->value;
+                    }
+                    else if(REL_Y == event->code)
+                    {
+                        dy += event->value;
+                    }
+                    break;
+                case EV_KEY:
+                    keys++;
+                    break;
+                case EV_SYN:
+                    reports++;
+                    break;
+            }
+            if(!quiet)
+            {
+                printf("type %d code %d value %d\n", event->type, event->code, event->value);
+            }
+        }
+        if(!quiet)
+        {
+            fflush(stdout);
+        }
+    }
+
+    printf("Received %ld events (%ld reports, %ld key/button events) in %ld reads\n", total, reports, keys, reads);
+    printf("Pointer moved by (%ld, %ld)\n", dx, dy);
+
+    close(fd);
+    unlink(path);
+    return 0;
+}
+
+/*
+   signal handler; ends the read loop
+
+   @param int signal unused
+ */
+void stop(int signal)
+{
+    running = false;
+}
@@ -1,11 +1,30 @@
 /*
    Author: James Pangia
   
-   usage: ./js2mouse [deviceName] [L]
+   usage: ./js2mouse [deviceName] [L] [A|H] [F] [M]
   
     deviceName: the name of the joystick device to read; expects a js* device name
                 If no device is specified, /dev/input/js0 is used.
+                An absolute path is used as is; a regular file is replayed as a
+                recorded session (record one with `cat /dev/input/js0 > session.js`)
+                event* names (e.g. event5 or /dev/input/event5) are read as evdev devices
+                unix:<path> listens on a Unix socket at <path> for a virtual controller
+                that streams struct js_event records
     L: specify that the left joystick should move the cursor (default uses right)
+    A: absolute mode; stick deflection maps directly to a point in the ABS_REGION_* rectangle
+    H: hybrid mode; flicking the stick past FLICK_DEADZ jumps to a point in the region,
+       smaller deflections nudge the cursor relatively for fine positioning
+    F: smooth the axes with a One-Euro filter before they move the cursor
+    M: give this controller its own pointer and keyboard focus (X Input multi-pointer);
+       run one js2mouse per controller. Needs a build with MPX_BACKEND (`make compile-mpx`)
+  
+   Buttons (per-gesture actions live in the gestureActions[] table):
+    A: left click; hold for LONG_PRESS_MS to right click
+    B: right click
+    X: middle click
+    LB/RB: scroll up/down; hold to keep scrolling
+    BACK: double-tap to quit
+    XBOX: quit
   
    Description:
    reads the inputs from the specified joystick device and uses the joystick for
@@ -19,8 +38,17 @@
     xdotool 
         standalone in Debian-based systems; installed with `sudo apt install xdotool`
         standalone for Arch-based as well; installed with `sudo pacman -S[yu] xdotool`s
+    libX11 and libXtst (only when built with X11_BACKEND set to 1, see `make compile-x11`)
+        the X11 build also switches between the profiles in the profiles[] table
+        as the focused window changes
+        and resolves the keysym bindings in profiles[] to keycodes once, instead of per press
+    libXi and libXtst (only when built with MPX_BACKEND set to 1, see `make compile-mpx`)
+    ydotoold (only when built with YDOTOOL_BACKEND set to 1, see `make compile-ydotool`);
+        replaces xdotool on Wayland. fakeydotoold.c is a stand-in for testing
 */
 
+#define _GNU_SOURCE //for accept4()
+
 #include <stdlib.h> //for system()
 #include <stdio.h>
 #include <stdbool.h> //bool, true/false
@@ -29,12 +57,81 @@
 #include <linux/joystick.h> //for js_event struct and related constants
 #include <fcntl.h> //for open() function
 #include <time.h> //for time()
+#include <sys/ioctl.h> //for ioctl()
+#include <sys/stat.h> //for fstat()
+#include <stdarg.h> //for va_list in logWrite()
+#include <stdatomic.h> //for the lock-free log ring
+#include <pthread.h> //for the log flushing thread
+#include <errno.h> //for errno and EAGAIN
+#include <sys/socket.h> //for the virtual controller socket
+#include <sys/un.h> //for struct sockaddr_un
+#include <poll.h> //for poll()
+#include <sys/inotify.h> //for waiting on a disconnected device to come back
+#include <sys/eventfd.h> //for waking the log thread
 
 /*preprocessor constants*/
 
 //debug flag: 0 for no debug mode, 1 for debug
 #define DEBUG 0
 
+//log levels; messages below LOG_LEVEL are compiled out
+#define LOG_DEBUG 0
+#define LOG_INFO 1
+#define LOG_WARN 2
+#define LOG_ERROR 3
+#if DEBUG
+#define LOG_LEVEL LOG_DEBUG
+#else
+#define LOG_LEVEL LOG_INFO
+#endif
+
+#define LOG_RING_SIZE 256 //records the log ring holds; must be a power of two
+#define LOG_RECORD_LEN 128 //longest formatted log message, including the newline
+
+//logging macros; the event loop logs through these instead of printf so it never blocks on stdout.
+//the level test is a constant, so disabled levels cost nothing
+#define logDebug(...) do { if(LOG_LEVEL <= LOG_DEBUG) logWrite(__VA_ARGS__); } while(0)
+#define logInfo(...)  do { if(LOG_LEVEL <= LOG_INFO)  logWrite(__VA_ARGS__); } while(0)
+#define logWarn(...)  do { if(LOG_LEVEL <= LOG_WARN)  logWrite(__VA_ARGS__); } while(0)
+#define logError(...) do { if(LOG_LEVEL <= LOG_ERROR) logWrite(__VA_ARGS__); } while(0)
+
+//output flag: 0 to inject pointer motion with xdotool, 1 to move the pointer in-process with Xlib
+//normally set from the makefile (make compile-x11) since it needs -lX11
+#ifndef X11_BACKEND
+#define X11_BACKEND 0
+#endif
+
+//multi-pointer flag: 1 to support the M argument, which injects through an X Input master
+//pointer/keyboard pair of its own; needs X11_BACKEND and -lXi -lXtst (make compile-mpx)
+#ifndef MPX_BACKEND
+#define MPX_BACKEND 0
+#endif
+#if MPX_BACKEND && !X11_BACKEND
+#error "MPX_BACKEND needs X11_BACKEND"
+#endif
+
+//Wayland flag: 1 to inject through a ydotoold daemon (the uinput device behind ydotool) over
+//one persistent socket instead of xdotool; start the daemon before js2mouse (make compile-ydotool)
+#ifndef YDOTOOL_BACKEND
+#define YDOTOOL_BACKEND 0
+#endif
+#if YDOTOOL_BACKEND && X11_BACKEND
+#error "YDOTOOL_BACKEND and X11_BACKEND are separate backends; pick one"
+#endif
+
+#if X11_BACKEND
+#include <X11/Xlib.h> //for XWarpPointer() and friends
+#include <X11/Xutil.h> //for XGetClassHint()
+#include <X11/Xatom.h> //for XA_WINDOW
+#include <strings.h> //for strcasecmp()
+#include <X11/extensions/XTest.h> //for XTestFakeKeyEvent() and XTestFakeButtonEvent()
+#endif
+
+#if MPX_BACKEND
+#include <X11/extensions/XInput2.h> //for XIChangeHierarchy() and XIWarpPointer()
+#include <X11/extensions/XInput.h> //for XOpenDevice()
+#endif
+
 //config constants
 #define DEVICE_N_LEN 256 //an arbitrary length that should be big enough; change if necessary
 #define CMD_LEN 256 //an arbitrary length that should be big enough; change if necessary
@@ -46,6 +143,33 @@
 #define D_PAD_DEADZ 1000
 
 #define TIME_OUT 5 //the time in seconds it takes for the device to time out
+#define STICK_TICK_MS 5 //while the stick is deflected, the cursor is nudged this often
+
+#define OUTPUT_QUEUE_SIZE 64 //injections waiting for the output thread
+#define OUTPUT_LATENCY_WEIGHT 8 //the backend latency estimate moves 1/this of the way to each new sample
+
+//absolute/hybrid pointer mode constants
+//the screen rectangle that full stick deflection spans; set to cover the desktop (or one monitor of it)
+#define ABS_REGION_X 0
+#define ABS_REGION_Y 0
+#define ABS_REGION_W 1920
+#define ABS_REGION_H 1080
+#define FLICK_DEADZ 24000 //in hybrid mode, deflection past this jumps to the region instead of nudging
+#define STICK_MAX 32767 //largest magnitude a js axis reports
+
+//One-Euro filter constants (see Casiez et al., "1 Euro Filter", CHI 2012)
+//lower FILTER_MIN_CUTOFF removes more jitter when the stick is held still;
+//higher FILTER_BETA lets fast stick motion through with less lag
+#define FILTER_MIN_CUTOFF 1.0f //cutoff frequency in Hz at zero stick speed
+#define FILTER_BETA 0.0005f //cutoff increase in Hz per axis unit/second of stick speed
+#define FILTER_D_CUTOFF 1.0f //cutoff frequency in Hz for the speed estimate
+#define FILTER_TAU_D (1.0f / (6.2831853f * FILTER_D_CUTOFF)) //time constant of the speed estimate in seconds
+#define FILTER_SETTLE 32 //a smoothed axis this close to the raw value is taken as the raw value
+#define DEFAULT_AXIS_COUNT 8 //used when the axis count can't be queried, like when replaying a file
+
+//input source constants
+#define EVENT_BATCH 64 //most events read per pass of the loop
+#define SOCKET_PREFIX "unix:" //device argument prefix for the virtual controller socket
 
 //button identifier constants
 #define A_BTN 0
@@ -75,15 +199,386 @@
 #define SCROLL_U 4  //scroll up
 #define SCROLL_D 5  //scroll down
 
-#define ARROW_U 111   //up arrow key
-#define ARROW_L 113   //left arrow key
-#define ARROW_R 114   //right arrow key
-#define ARROW_D 116   //down arrow key
+//gesture timing, in milliseconds of event time
+#define MAX_BUTTONS 16 //buttons the gesture engine tracks; higher button numbers are ignored
+#define DOUBLE_TAP_MS 250 //longest gap from releasing a tap to the next press that makes a double-tap
+#define LONG_PRESS_MS 500 //how long a button is held before it counts as a long-press
+#define REPEAT_DELAY_MS 400 //how long a hold-repeat button is held before it starts repeating
+#define REPEAT_MS 80 //time between repeats after that
+#define REPEAT_CATCH_UP 4 //most missed repeats made up when the loop falls behind; older ones are skipped
+
+#define YDOTOOL_SOCKET "/tmp/.ydotool_socket" //ydotoold's default; the YDOTOOL_SOCKET environment variable overrides it
+#define YDOTOOL_BATCH 64 //input events buffered before they go to ydotoold in one sendmmsg()
+
+//keys are bound by keysym name (as in `xev` output), optionally with modifiers: "ctrl+c", "alt+Left".
+//modifier names are ctrl, shift, alt and super, or any keysym
+#define ARROW_U "Up"    //up arrow key
+#define ARROW_L "Left"  //left arrow key
+#define ARROW_R "Right" //right arrow key
+#define ARROW_D "Down"  //down arrow key
+
+#define BINDING_LEN 64 //longest binding string
+#define MAX_MODIFIERS 4 //most modifiers one binding can hold
+
+#define NUDGE_DIVISOR 10000 //stick deflection per pixel of nudge; higher is a slower cursor
+#define NUDGE_SUBPIXELS 256 //nudges are worked out in 1/NUDGE_SUBPIXELS of a pixel and the fraction carried over
+
+//pointer modes, selected with the A and H arguments
+enum pointerMode
+{
+    POINTER_RELATIVE, //every event outside the deadzone nudges the cursor
+    POINTER_ABSOLUTE, //deflection outside the deadzone places the cursor in the region
+    POINTER_HYBRID    //deflection past FLICK_DEADZ places the cursor, below that it nudges
+};
+
+//kinds of injection the output thread performs
+enum outputKind
+{
+    OUTPUT_REL,   //move the pointer by (a, b)
+    OUTPUT_ABS,   //move the pointer to (a, b)
+    OUTPUT_CLICK, //click button a
+    OUTPUT_KEYS   //release binding a, then press binding b (indexes into the key table; -1 for neither)
+};
+
+struct outputCommand
+{
+    enum outputKind kind;
+    int a;
+    int b;
+};
+
+//injections queued for the output thread, so a slow backend never stalls the event loop.
+//pending motion is merged into the last queued command, so the queue can't fill with stale motion;
+//clicks and keys are never merged or dropped
+struct outputQueue
+{
+    struct outputCommand commands[OUTPUT_QUEUE_SIZE];
+    int head;  //oldest pending command
+    int count; //pending commands
+    bool running;
+    pthread_mutex_t lock;
+    pthread_cond_t ready; //signalled when a command is queued
+    pthread_cond_t space; //signalled when a command is taken
+    pthread_t thread;
+    atomic_long latencyUs; //running estimate of how long one injection takes; only reported on exit
+};
+
+struct outputQueue outputQueue = {.lock = PTHREAD_MUTEX_INITIALIZER,
+                                  .ready = PTHREAD_COND_INITIALIZER,
+                                  .space = PTHREAD_COND_INITIALIZER};
+
+//where events come from: a js device (or recording), an evdev device or a socket.
+//every source hands the loop struct js_event records, numbered like a js device
+struct inputSource
+{
+    const char* kind;  //"js", "evdev" or "socket", for messages
+    int fd;            //the device, the recording or the connected client; -1 if none
+    int listenFd;      //socket source: the listening socket
+    int axisCount;     //number of axes events can refer to
+    bool replay;       //js source: fd is a recorded session, read once to the end
+    int absMin[DEFAULT_AXIS_COUNT]; //evdev source: range of each axis, to rescale it like joydev does
+    int absMax[DEFAULT_AXIS_COUNT];
+    int absInit[DEFAULT_AXIS_COUNT]; //evdev source: axis values at open, handed out as init events
+    bool initPending;  //evdev source: absInit hasn't been read yet
+    size_t carryLen;   //socket source: bytes of an event split across reads
+    char carry[sizeof(struct js_event)];
+
+    //opens (or reopens) the source at path; returns 0 on success, else -1
+    int (*open)(struct inputSource* source, const char* path);
+    //reads up to max events into batch;
+    //returns how many, 0 at the end of a recording, -1 with errno set otherwise (EAGAIN if nothing waits)
+    ssize_t (*readEvents)(struct inputSource* source, struct js_event* batch, int max);
+    void (*close)(struct inputSource* source);
+};
+
+//D-pad directions, in the order a profile lists their bindings
+enum dpadKey
+{
+    DPAD_LEFT,
+    DPAD_RIGHT,
+    DPAD_UP,
+    DPAD_DOWN,
+    DPAD_KEYS
+};
+
+//per-application settings; picked by matching the class of the focused window
+struct profile
+{
+    const char* windowClass;     //WM_CLASS class to match (case-insensitive); NULL for the default profile
+    int nudgeDivisor;            //stick deflection per pixel of nudge; higher is a slower cursor
+    const char* keys[DPAD_KEYS]; //bindings the D-pad holds, by enum dpadKey
+};
+
+//the first entry is the default, used when no other class matches.
+//add an entry per application; windowClass is the second string `xprop WM_CLASS` prints
+const struct profile profiles[] =
+{
+    {NULL,      NUDGE_DIVISOR,     {ARROW_L, ARROW_R, ARROW_U, ARROW_D}},
+    {"FreeCAD", NUDGE_DIVISOR * 3, {ARROW_L, ARROW_R, ARROW_U, ARROW_D}}, //slower cursor for precise CAD work
+    {"firefox", NUDGE_DIVISOR,     {"alt+Left", "alt+Right", "Page_Up", "Page_Down"}}, //back/forward and paging
+};
+#define PROFILE_COUNT (sizeof(profiles) / sizeof(profiles[0]))
+#define PROFILE_CACHE_SIZE 16 //windows whose profile the focus thread remembers
+
+//a binding resolved to what gets injected.
+//in X11 builds the names are turned into keycodes once, so a press is a table read;
+//otherwise keycode stays 0 and xdotool is handed the name
+struct keyBinding
+{
+    const char* name;               //the binding as written in profiles[]
+    int keycode;                    //0 if unresolved, -1 if it names no key on this keymap
+    int modifierCount;
+    int modifiers[MAX_MODIFIERS];   //keycodes held around keycode, outermost first
+};
+
+//flat key table, indexed by keyIndex(). Rebuilt by the focus thread on keymap changes
+//while the output thread reads it, so both go through keyTableLock: the rebuild only
+//holds it to copy the finished table in, a reader only to copy out one binding
+struct keyBinding keyTable[PROFILE_COUNT * DPAD_KEYS];
+pthread_mutex_t keyTableLock = PTHREAD_MUTEX_INITIALIZER;
+
+//the profile in use; written by the focus thread, read once per event by the loop
+_Atomic(const struct profile*) activeProfile = &profiles[0];
+
+//gestures the engine recognizes on each button
+enum gesture
+{
+    GESTURE_TAP,        //press and release; fires on the press when the button has no long-press or double-tap
+    GESTURE_DOUBLE_TAP, //a second press within DOUBLE_TAP_MS of releasing a tap
+    GESTURE_LONG_PRESS, //held for LONG_PRESS_MS
+    GESTURE_REPEAT,     //fires on the press, then every REPEAT_MS once held for REPEAT_DELAY_MS
+    GESTURES
+};
+
+//what a gesture does
+enum actionKind
+{
+    ACTION_NONE,
+    ACTION_CLICK, //clicks mouse button argument (a CLICK_* or SCROLL_* constant)
+    ACTION_QUIT   //exits js2mouse
+};
+
+struct gestureAction
+{
+    enum actionKind kind;
+    int argument;
+};
+
+//actions per button and gesture; a button only waits to tell gestures apart if it has more than a tap
+const struct gestureAction gestureActions[MAX_BUTTONS][GESTURES] =
+{
+    [A_BTN]    = {[GESTURE_TAP] = {ACTION_CLICK, CLICK_L}, [GESTURE_LONG_PRESS] = {ACTION_CLICK, CLICK_R}},
+    [B_BTN]    = {[GESTURE_TAP] = {ACTION_CLICK, CLICK_R}},
+    [X_BTN]    = {[GESTURE_TAP] = {ACTION_CLICK, CLICK_M}},
+    [LB_BTN]   = {[GESTURE_REPEAT] = {ACTION_CLICK, SCROLL_U}}, //hold to keep scrolling
+    [RB_BTN]   = {[GESTURE_REPEAT] = {ACTION_CLICK, SCROLL_D}},
+    [BACK_BTN] = {[GESTURE_DOUBLE_TAP] = {ACTION_QUIT, 0}}, //for when the system grabs XBOX_BTN
+    [XBOX_BTN] = {[GESTURE_TAP] = {ACTION_QUIT, 0}},
+};
+
+const char* const gestureNames[GESTURES] = {"tap", "double-tap", "long-press", "repeat"};
+
+//where a button is in telling its gestures apart
+enum gestureStage
+{
+    STAGE_IDLE,    //up
+    STAGE_PRESSED, //down, waiting to see if it's a tap or a long-press
+    STAGE_HELD,    //down and already acted on; repeating if it has GESTURE_REPEAT
+    STAGE_TAPPED   //tapped once, waiting to see if a second tap follows
+};
+
+struct buttonGesture
+{
+    enum gestureStage stage;
+    unsigned int deadline; //event time the button's timer fires at
+    int heapIndex;         //where the button sits in timers, -1 if it has no timer
+};
+
+//gesture state: one slot per button, and the pending timers as a min-heap of button
+//numbers ordered by deadline, so the loop can sleep until exactly the next one
+struct gestureEngine
+{
+    struct buttonGesture buttons[MAX_BUTTONS];
+    int timerCount;
+    int timers[MAX_BUTTONS];
+    bool clockKnown;
+    unsigned int clockOffset; //smallest (nowMs() - event time) seen; maps event time onto nowMs()
+};
+
+struct gestureEngine gestures;
+
+//counts of injected events; printed on exit to compare pointer modes
+struct injectStats
+{
+    long relMoves;
+    long absMoves;
+    long buttons;
+    long keys;
+    long reconnects;
+    long long reconnectMs; //total time spent reattaching, from the device reappearing to being read again
+    long gestures[GESTURES]; //recognized gestures, by enum gesture
+    long long recognitionMs; //total time from the deciding event or deadline to the gesture's action
+    long long recognitionMaxMs;
+};
+
+struct injectStats stats = {0};
+
+//One-Euro filter state for one axis
+struct oneEuro
+{
+    bool primed;       //false until the first sample
+    float value;       //last filtered value
+    float speed;       //last filtered rate of change in units/second
+    unsigned int time; //event time of the last sample in milliseconds
+    unsigned int dtMs; //gap to the previous sample; the loop ticks at a steady rate, so it rarely changes
+    float rate;        //1 / dt in 1/seconds, for dtMs
+    float alphaD;      //smoothing factor of the speed estimate, for dtMs
+};
+
+#if X11_BACKEND
+Display* display = NULL; //connection used by the pointer functions
+
+//recently focused windows and their profiles, so switching back and forth
+//between windows doesn't ask the server for WM_CLASS each time
+struct profileCache
+{
+    int next;                                            //slot replaced next
+    Window windows[PROFILE_CACHE_SIZE];                  //None for an empty slot
+    const struct profile* profiles[PROFILE_CACHE_SIZE];
+};
+
+void startFocusThread(void);
+void* focusThread(void* arg);
+const struct profile* cachedProfile(struct profileCache* cache, Display* focusDisplay, Window window);
+void forgetWindow(struct profileCache* cache, Window window);
+const struct profile* findProfile(Display* focusDisplay, Window window);
+int ignoreXError(Display* errDisplay, XErrorEvent* error);
+#endif
+
+#if MPX_BACKEND
+//this controller's master pointer/keyboard pair, and the XTEST slaves the server gives it;
+//set up by mpxCreate() when M is given, otherwise injection goes to the core pointer
+struct mpxDevices
+{
+    bool active;
+    int pointer;        //master pointer device id
+    int keyboard;       //master keyboard device id
+    XDevice* fakePointer;  //XTEST slave of pointer, for clicks
+    XDevice* fakeKeyboard; //XTEST slave of keyboard, for keys
+};
+
+struct mpxDevices mpx = {0};
+
+int mpxCreate(const char* name);
+void mpxRemove(void);
+#endif
+
+#if YDOTOOL_BACKEND
+//connection to ydotoold. ydotoold takes one struct input_event per datagram and writes it
+//to its uinput device, so the client side is just a buffer of events and a socket
+struct ydotoolClient
+{
+    int fd;
+    struct sockaddr_un address;
+    int count;                                 //events waiting in events[]
+    struct input_event events[YDOTOOL_BATCH];
+    long batches;                              //sendmmsg() calls, for the stats
+    long sent;                                 //events delivered
+};
+
+struct ydotoolClient ydotool = {-1};
+
+int ydotoolConnect(const char* path);
+void ydotoolEmit(int type, int code, int value);
+int ydotoolFlush(void);
+int ydotoolKeycode(const char* keysymName);
+#endif
+
+//one formatted log message
+struct logRecord
+{
+    atomic_uint seq; //which lap of the ring this slot is on; see logWrite()
+    int len;
+    char text[LOG_RECORD_LEN];
+};
+
+//bounded lock-free log queue: any thread can write, the log thread reads
+struct logRing
+{
+    struct logRecord records[LOG_RING_SIZE];
+    atomic_uint head;     //next slot to write
+    atomic_uint tail;     //next slot to read; only touched by the reader
+    atomic_ulong dropped; //messages lost because the ring was full
+    atomic_bool running;  //cleared to stop the log thread
+    atomic_bool wakePending; //set by the first writer after the log thread last woke
+    int wakeFd;           //eventfd the log thread sleeps on
+    pthread_mutex_t flushLock; //logFlush() has one reader at a time, whichever thread calls it
+    pthread_t thread;
+};
+
+struct logRing logRing = {.wakeFd = -1, .flushLock = PTHREAD_MUTEX_INITIALIZER};
+
+void logStart(void);
+void logStop(void);
+void logWrite(const char* format, ...);
+void logFlush(void);
+void* logThread(void* arg);
+
+int openJsSource(struct inputSource* source, const char* path);
+ssize_t readJsEvents(struct inputSource* source, struct js_event* batch, int max);
+int openEvdevSource(struct inputSource* source, const char* path);
+ssize_t readEvdevEvents(struct inputSource* source, struct js_event* batch, int max);
+int evdevAxisNumber(int code);
+int evdevButtonNumber(int code);
+int openSocketSource(struct inputSource* source, const char* path);
+ssize_t readSocketEvents(struct inputSource* source, struct js_event* batch, int max);
+void closeSocketSource(struct inputSource* source);
+void closeFdSource(struct inputSource* source);
+int waitForDevice(struct inputSource* source, const char* path, long long* appearedMs);
+long long nowMs(void);
+
+void outputStart(void);
+void outputStop(void);
+void queueOutput(enum outputKind kind, int a, int b);
+void cancelMotion(void);
+void* outputThread(void* arg);
+int inject(const struct outputCommand* command);
+
+int movePointerRel(int dx, int dy);
+int movePointerAbs(int x, int y);
+int pressButton(int button);
+
+float oneEuroFilter(struct oneEuro* filter, float value, unsigned int time, float minCutoff, float beta);
+int smoothAxis(struct oneEuro* filter, int value, unsigned int time);
+
+void gestureReset(void);
+int gesturePress(int button, unsigned int time);
+int gestureRelease(int button, unsigned int time);
+int gestureExpire(unsigned int now);
+int gestureWaitMs(void);
+bool gestureActive(void);
+int fireGesture(int button, enum gesture gesture, unsigned int decidedAt);
+void syncEventClock(unsigned int time);
+unsigned int eventClockNow(void);
+void gestureTimerSet(int button, unsigned int deadline);
+void gestureTimerCancel(int button);
+void gestureTimerSift(int index);
 
-int handleDpadH(int value);
-int handleDpadV(int value);
+int dpadDirection(int value, int deadZone);
+int stickNudge(int value, int deadZone, int divisor);
+int stickTarget(int value, int origin, int size);
 
-int handleStick(const int* axes, int axes_len, int hAxisNum, int vAxisNum, int deadZone);
+void resolveBindings(void* keyDisplay);
+int keyIndex(const struct profile* profile, enum dpadKey key);
+const struct keyBinding* loadBinding(int index, struct keyBinding* copy);
+
+int holdDpadKey(int* held, int key);
+int handleDpadH(int value, const struct profile* profile);
+int handleDpadV(int value, const struct profile* profile);
+
+int handleStick(const int* axes, int axes_len, int hAxisNum, int vAxisNum, int deadZone, int divisor);
+void releaseController(const struct profile* profile, int* axes, int* smoothAxes, struct oneEuro* filters, int axisCount);
+int handleStickAbs(const int* axes, int axes_len, int hAxisNum, int vAxisNum, int deadZone, int flickZone, int divisor);
 
 int main(int argc, char* argv[])
 {
@@ -98,96 +593,218 @@ int main(int argc, char* argv[])
     bool lefty = false;
 
     //time elapsed since last event
-    time_t timeSince = time(NULL); printf("moo\n");//debug
-    // printf("%d\n", timeSince); //debug
+    time_t timeSince = time(NULL);
 
-#if DEBUG
-    printf("Running in debug mode. . .\n");
-    sleep(2);
-#endif
+    //return codes of the setup and handler calls
+    int success = 0;
 
     //TODO: make sure that xdotool is available
     //check config file; it should specify ydotool or xdotool
     //dummy call to tool using execl
     //if execl sends fail, send an error and quit
 
-    //check the first argument
-    if(argc == 2)
+    //pointer mode; relative unless A or H is given
+    enum pointerMode mode = POINTER_RELATIVE;
+
+    //smoothing flag; set with F
+    bool smooth = false;
+
+    //multi-pointer flag; set with M
+    bool multiPointer = false;
+
+    //check the arguments; L, A and H are flags, anything else is the device name
+    const char* deviceName = "js0";
+    for(int i = 1; i < argc; i++)
     {
-        if(0 == strcmp(argv[1], "L"))
+        if(0 == strcmp(argv[i], "L"))
         {
             printf("Running in left-handed mode. . .\n");
             lefty = true;
         }
+        else if(0 == strcmp(argv[i], "A"))
+        {
+            printf("Running in absolute pointer mode. . .\n");
+            mode = POINTER_ABSOLUTE;
+        }
+        else if(0 == strcmp(argv[i], "H"))
+        {
+            printf("Running in hybrid pointer mode. . .\n");
+            mode = POINTER_HYBRID;
+        }
+        else if(0 == strcmp(argv[i], "F"))
+        {
+            printf("Smoothing stick input. . .\n");
+            smooth = true;
+        }
+        else if(0 == strcmp(argv[i], "M"))
+        {
+            multiPointer = true;
+        }
         else
         {
-            printf("Using device [%s] to control mouse and keyboard inputs. . .\n", argv[1]);
-            //set device path
-            strcat(devicePath, argv[1]);
+            deviceName = argv[i];
         }
     }
-    //check for an L argument after a device
-    else if(argc >= 3 && 0 == strcmp(argv[2], "L"))
+
+    //pick the input source from the device argument and open it
+    struct inputSource source;
+    if(0 == strncmp(deviceName, SOCKET_PREFIX, strlen(SOCKET_PREFIX)))
     {
-        printf("Running in left-handed mode. . .\n");
-        lefty = true;
+        //unix:<path> listens for a virtual controller
+        strncpy(devicePath, deviceName + strlen(SOCKET_PREFIX), DEVICE_N_LEN - 1);
+        devicePath[DEVICE_N_LEN - 1] = '\0';
+        success = openSocketSource(&source, devicePath);
     }
-    //default message
     else
     {
-        printf("Using device js0 to control mouse and keyboard inputs. . .\n");
-        strcat(devicePath, "js0");
+        //set device path; absolute paths are taken as is
+        if(strlen(DEV_DIR) + strlen(deviceName) >= DEVICE_N_LEN)
+        {
+            printf("Error: device name %s is too long\nExiting....", deviceName);
+            return -1;
+        }
+        if('/' == deviceName[0])
+        {
+            strcpy(devicePath, deviceName);
+        }
+        else
+        {
+            strcat(devicePath, deviceName);
+        }
+
+        //event* names are evdev devices, anything else is a js device or a recording
+        const char* baseName = strrchr(devicePath, '/') + 1;
+        if(0 == strncmp(baseName, "event", strlen("event")))
+        {
+            success = openEvdevSource(&source, devicePath);
+        }
+        else
+        {
+            success = openJsSource(&source, devicePath);
+        }
+    }
+    if(0 != success)
+    {
+        printf("Error: failed to open device %s\nExiting....", devicePath);
+        return -1;
+    }
+    printf("Using %s source [%s] to control mouse and keyboard inputs. . .\n", source.kind, devicePath);
+    if(source.replay)
+    {
+        printf("Replaying recorded session. . .\n");
+    }
+
+    if(POINTER_RELATIVE != mode)
+    {
+        printf("Using region %dx%d+%d+%d\n", ABS_REGION_W, ABS_REGION_H, ABS_REGION_X, ABS_REGION_Y);
+    }
+
+#if X11_BACKEND
+    XInitThreads(); //the focus thread has its own connection, but Xlib still shares state between them
+    display = XOpenDisplay(NULL);
+    if(NULL == display)
+    {
+        printf("Error: failed to open X display\nExiting....");
+        return -1;
+    }
+    XSetErrorHandler(ignoreXError); //a window can close between hearing about it and asking about it
+#endif
+
+    if(multiPointer)
+    {
+#if MPX_BACKEND
+        //name the pair after the device so each operator can tell theirs apart in `xinput list`
+        char mpxName[DEVICE_N_LEN + sizeof("js2mouse ")];
+        //(socket paths like unix:pad1 have no directory part)
+        const char* slash = strrchr(devicePath, '/');
+        snprintf(mpxName, sizeof(mpxName), "js2mouse %s", (NULL != slash) ? slash + 1 : devicePath);
+        if(0 != mpxCreate(mpxName))
+        {
+            printf("Error: failed to create a master pointer (is X Input 2.0 available?)\nExiting....");
+            return -1;
+        }
+        printf("Using pointer [%s pointer]. . .\n", mpxName);
+#else
+        printf("Warning: built without MPX_BACKEND; M is ignored\n");
+#endif
+    }
+
+#if YDOTOOL_BACKEND
+    const char* ydotoolPath = (NULL != getenv("YDOTOOL_SOCKET")) ? getenv("YDOTOOL_SOCKET") : YDOTOOL_SOCKET;
+    if(0 != ydotoolConnect(ydotoolPath))
+    {
+        printf("Error: failed to connect to ydotoold at [%s] (is it running?)\nExiting....", ydotoolPath);
+        return -1;
     }
+    printf("Injecting through ydotoold at [%s]. . .\n", ydotoolPath);
+#endif
 
     //TODO: move lots of the constants to a config
     printf("Using deadzone values:\n");
     printf("\tR_STICK_DEADZ: %d\n\tL_STICK_DEADZ: %d\n", R_STICK_DEADZ, L_STICK_DEADZ);
     printf("\tD_PAD_DEADZ: %d\n", D_PAD_DEADZ);
 
-    //struct for the event that gets read
-    struct js_event event;
+    //from here on the event loop logs through the ring
+    //(started first so warnings about bindings that don't resolve get printed too)
+    logStart();
+    logDebug("Running in debug mode. . .\n");
 
-    //open the device for reading
-//     int js = open(devicePath, O_RDONLY); //blocking read: blocks program if nothing to read
-    int js = open(devicePath, O_NONBLOCK); // nonblocking; just moves on if there's nothing to read
-    if(js < 0)
-    {
-        printf("Error: failed to open device %s\nExiting....", devicePath);
-        return -1;
-    }
-    
+    //look up every binding's keycodes now, rather than on every press
+#if X11_BACKEND
+    resolveBindings(display);
+#else
+    resolveBindings(NULL);
+#endif
+
+#if X11_BACKEND
+    startFocusThread();
+#endif
 
     //get the number of axes in the device
-    int axisCount = 0;
-    ioctl(js, JSIOCGAXES, &axisCount);
+    int axisCount = source.axisCount;
 
-    printf("axisCount: %d\n", axisCount); //debug
-    printf("sizeof(int): %ld\n", sizeof(int)); //debug
+    logDebug("axisCount: %d\n", axisCount);
 
     //dynamically allocate an array of axis values, with one cell per axis
     int* axes = (int*) calloc(axisCount, sizeof(int)); //gives an array filled with 0's
 
+    //smoothed copy of axes and the filter state behind it; only used with F
+    int* smoothAxes = (int*) calloc(axisCount, sizeof(int));
+    struct oneEuro* filters = (struct oneEuro*) calloc(axisCount, sizeof(struct oneEuro));
+
     // getchar(); //put a getchar here and the memory bug from reading stdin stops....
 
-    //read first event
-    /*size_t numRead = */read(js, &event, sizeof(struct js_event));
+    //events read together; sources write straight into this
+    struct js_event batch[EVENT_BATCH];
 
-    //command string that gets prepared using sprintf and executed using system()
-    char cmd[CMD_LEN];
+    //injections run on their own thread from here on
+    outputStart();
+    gestureReset();
 
     //a flag to quit the loop; gets set when XBOX_BTN is pressed
     bool quit = false;
 
+    //the source is waited on with poll(); a stick that's moving wakes the loop every STICK_TICK_MS
+    struct pollfd waitFd;
+
     //begin loop to read all the events until it's time to quit
-    //TODO: for some reason read() is returning 18,446,744,073,709,551,615 = (2^64)-1, not -1 when the joystick disconnects
+    //(the "(2^64)-1" read() result on disconnect was -1 printed as unsigned)
     while(!quit)
     {
+        //a button that's held or mid-gesture counts as input, so a long hold-repeat isn't interrupted
+        if(gestureActive())
+        {
+            timeSince = time(NULL);
+        }
+
         //check the timeout
         if( (time(NULL) - timeSince) > TIME_OUT)
         {
+            logFlush(); //keep queued messages ahead of the prompt
             printf("It has been %d seconds since last input.\n", TIME_OUT);
             printf("Do you want to quit (y/n): ");
             // printf("\n");
+            fflush(stdout);
             
             char inC = getchar(); //TODO: crashes as soon as I try to read user input....
             if('y' == inC)
@@ -199,134 +816,257 @@ int main(int argc, char* argv[])
             timeSince = time(NULL); //reset timeSince
         }
 
-        #if DEBUG
-            printf("\nnumRead: %lu\n\n", numRead);
-            printf("Event time: %d\n", event.time);
-            printf("Event value: %d\n", event.value);
-            printf("Event type: %d\n", event.type);
-            if(JS_EVENT_AXIS == event.type)
+        //sleep until there's input, the stick needs another nudge, or the timeout is due
+        //(or a gesture timer is due)
+        int waitMs = (1 == success) ? STICK_TICK_MS : (int) (TIME_OUT + 1 - (time(NULL) - timeSince)) * 1000;
+        int gestureMs = gestureWaitMs();
+        if(gestureMs >= 0 && gestureMs < waitMs)
+        {
+            waitMs = gestureMs;
+        }
+        waitFd.fd = (source.fd >= 0) ? source.fd : source.listenFd;
+        waitFd.events = POLLIN;
+        poll(&waitFd, 1, waitMs < 0 ? 0 : waitMs);
+
+        //read whatever events are waiting
+        //(an unplugged device wakes poll() with POLLHUP/POLLERR and then fails the read with ENODEV)
+        ssize_t eventCount = source.readEvents(&source, batch, EVENT_BATCH);
+        if(0 == eventCount) //end of the recording
+        {
+            break;
+        }
+
+        //one load per batch; focus changes swap the pointer from the focus thread
+        const struct profile* profile = atomic_load_explicit(&activeProfile, memory_order_acquire);
+
+        if(eventCount < 0 && ENODEV == errno)
+        {
+            long long lostMs = nowMs();
+            logWarn("Device %s disconnected; waiting for it to come back. . .\n", devicePath);
+
+            //let go of everything so nothing stays held or keeps moving while it's gone
+            releaseController(profile, axes, smoothAxes, filters, axisCount);
+            success = 0;
+
+            source.close(&source);
+            long long appearedMs = 0;
+            if(0 != waitForDevice(&source, devicePath, &appearedMs))
+            {
+                logError("Error: can't watch for %s to come back\n", devicePath);
+                break;
+            }
+            long long attachMs = nowMs() - appearedMs;
+            stats.reconnects++;
+            stats.reconnectMs += attachMs;
+            //axes get rebuilt from the init events the reopened device sends first
+            logInfo("Device reconnected after %lld ms; reattached %lld ms after it reappeared\n",
+                    nowMs() - lostMs, attachMs);
+            timeSince = time(NULL);
+            continue;
+        }
+
+        //a virtual controller hung up; the socket keeps listening for the next one
+        if(eventCount < 0 && ECONNRESET == errno)
+        {
+            releaseController(profile, axes, smoothAxes, filters, axisCount);
+            success = 0;
+            timeSince = time(NULL);
+            continue;
+        }
+
+        //buttons and the D-pad act on each new event
+        for(ssize_t i = 0; i < eventCount && !quit; i++)
+        {
+            struct js_event event = batch[i];
+
+            logDebug("event time: %u, value: %d, type: %d, number: %d\n",
+                     event.time, event.value, event.type, event.number);
+
+            //book-keep the axes
+            //(button numbers aren't axis numbers; only axis events go in axes)
+            if(JS_EVENT_AXIS == (event.type & ~JS_EVENT_INIT) && event.number < axisCount)
+            {
+                axes[event.number] = event.value;
+                if(smooth)
+                {
+                    smoothAxes[event.number] = smoothAxis(&filters[event.number], event.value, event.time);
+                }
+            }
+
+            //gestures run on event time; timers due before this event fire first, so a
+            //release that was read late still lands on the right side of a deadline
+            if(0 == (event.type & JS_EVENT_INIT))
+            {
+                syncEventClock(event.time);
+                quit = (0 != gestureExpire(event.time)) || quit;
+            }
+
+            //handle buttons; presses and releases both go to the gesture engine, which acts
+            //through gestureActions[]
+            if(JS_EVENT_BUTTON == event.type && !quit)
+            {
+                timeSince = time(NULL);
+                //TODO: make LB/RB scroll the other way if L is specified in run command
+                if(event.number >= MAX_BUTTONS)
+                {
+                    logDebug("Unhandled event number: %d\n", event.number);
+                }
+                else if(event.value)
+                {
+                    quit = (0 != gesturePress(event.number, event.time));
+                }
+                else
+                {
+                    quit = (0 != gestureRelease(event.number, event.time));
+                }
+            }
+
+            //handle dpad
+            else if(JS_EVENT_AXIS == event.type)
             {
-                printf("Axis number: %d\n", event.number);
+                int success = -1;
+                switch(event.number)
+                {
+                    //d-pad moves arrow keys
+                    case D_PAD_H:
+                        success = handleDpadH(event.value, profile);
+                        if(0 == success)
+                        {
+                            timeSince = time(NULL);
+                        }
+                        break;
+                    case D_PAD_V:
+                        success = handleDpadV(event.value, profile);
+                        if(0 == success)
+                        {
+                            timeSince = time(NULL);
+                        }
+                        break;
+                    /*
+                    default:
+                        printf("Unhandled event number: %d\n", event.number); //maybe remove if this is too annoying
+                        break;
+                    */
+                }
             }
-            if(JS_EVENT_BUTTON == event.type)
+        }
+
+        //timers that came due while nothing was read
+        quit = (0 != gestureExpire(eventClockNow())) || quit;
+
+        //js devices only report changes, so the filters also step on every pass with the
+        //current raw values; otherwise a held or released stick would leave them short of it
+        if(smooth)
+        {
+            unsigned int now = eventClockNow();
+            for(int axis = 0; axis < axisCount; axis++)
             {
-                printf("button number: %d\n", event.number);
+                if(filters[axis].primed && (int) (now - filters[axis].time) > 0)
+                {
+                    smoothAxes[axis] = smoothAxis(&filters[axis], axes[axis], now);
+                }
             }
-        #endif
+        }
 
-        int success = 0;
         int hStick = 0; //just used in error reporting
         int vStick = 0; //just used in error reporting
+        int deadZone = 0;
         // time_t lastTimeSince = timeSince;
 
-        //constantly update mouse
-        axes[event.number] = event.value;
+        //constantly update mouse, whether or not anything new was read;
+        //js devices only report changes, so a held stick sends nothing
+        const int* stickAxes = smooth ? smoothAxes : axes;
         if(lefty) //left-hand mode
         {
             hStick = L_STICK_H;
             vStick = L_STICK_V;
-            success = handleStick(axes, axisCount, L_STICK_H, L_STICK_V, L_STICK_DEADZ);
-            
+            deadZone = L_STICK_DEADZ;
         }
         else //right hand mode
         {
             hStick = R_STICK_H;
             vStick = R_STICK_V;
-            success = handleStick(axes, axisCount, R_STICK_H, R_STICK_V, R_STICK_DEADZ);
+            deadZone = R_STICK_DEADZ;
         }
 
-        if(-1 == timeSince) //report if function errored
+        if(POINTER_RELATIVE == mode)
         {
-            printf("Error: Tried to move an axis the device does not have\n");
-            printf("\tAxes to move: %d, %d\n\tAxis count: %d\n", hStick, vStick, axisCount);
-            timeSince = time(NULL); //reset the time
+            success = handleStick(stickAxes, axisCount, hStick, vStick, deadZone, profile->nudgeDivisor);
         }
-        //if the values were in the deadzone
-        else if(1 == success)
+        else
         {
-            timeSince = time(NULL); printf("moo\n");//debug //reset the time to before the joystick was handled
+            //absolute mode is hybrid mode where every deflection counts as a flick
+            success = handleStickAbs(stickAxes, axisCount, hStick, vStick, deadZone,
+                                     POINTER_ABSOLUTE == mode ? deadZone : FLICK_DEADZ, profile->nudgeDivisor);
         }
 
-        //handle buttons, taking button press events, excluding button release events
-        if(JS_EVENT_BUTTON == event.type && true == event.value)
+        //a smoothed stick that hasn't caught up with the raw one yet still needs the next tick
+        if(0 == success && smooth && hStick < axisCount && vStick < axisCount
+           && (smoothAxes[hStick] != axes[hStick] || smoothAxes[vStick] != axes[vStick]))
         {
-            timeSince = time(NULL);
-            //TODO: move this logic into a button handler function
-            switch(event.number)
-            {
-                case A_BTN: //A is left click
-                    printf("left click!\n");
-                    sprintf(cmd, "xdotool click %d", CLICK_L);
-                    system(cmd);
-                    break;
-                case B_BTN: //B is right click
-                    printf("right click!\n");
-                    sprintf(cmd, "xdotool click %d", CLICK_R);
-                    system(cmd);
-                    break;
-                case X_BTN: //X is middle click
-                    printf("middle click!\n"); //gonna have to fix my middle-click functionality before working on this....
-                    sprintf(cmd, "xdotool click %d", CLICK_M);
-                    system(cmd);
-                    break;
-                case RB_BTN: //RB is scroll down (unless option L is specified)
-                    printf("scroll down!\n");
-                    //TODO: make RB scroll up if L is specified in run command
-                    break;
-                case LB_BTN: //LB is scroll up (unless option L is specified)
-                    printf("scroll up!\n");
-                    //TODO: make LB scroll down if L is specified in run command
-                    break;
-                case XBOX_BTN: //exits the program
-                    quit = true;
-                    printf("quit!\n");
-                    break;
-                default:
-                    printf("Unhandled event number: %d\n", event.number); //maybe remove if this is too annoying
-                    break;
-            }
+            success = 1;
         }
 
-        //handle dpad
-        else if(JS_EVENT_AXIS == event.type)
+        if(-1 == success) //report if function errored
         {
-            int success = -1;
-            switch(event.number)
-            {
-                //d-pad moves arrow keys
-                case D_PAD_H:
-                    success = handleDpadH(event.value);
-                    if(0 == success)
-                    {
-                        timeSince = time(NULL); printf("moo\n");//debug
-                    }
-                    break;
-                case D_PAD_V:
-                    success = handleDpadV(event.value);
-                    if(0 == success)
-                    {
-                        timeSince = time(NULL); printf("moo\n");//debug
-                    }
-                    break;
-                /*
-                default:
-                    printf("Unhandled event number: %d\n", event.number); //maybe remove if this is too annoying
-                    break;
-                */
-            }
+            logError("Error: Tried to move an axis the device does not have\n");
+            logError("\tAxes to move: %d, %d\n\tAxis count: %d\n", hStick, vStick, axisCount);
+            timeSince = time(NULL); //reset the time
         }
-
-        if(access(devicePath, O_RDONLY) != -1)
+        //if the values were in the deadzone
+        else if(1 == success)
         {
-            //read a new event if the file is accessible
-            /*numRead = */read(js, &event, sizeof(struct js_event));
+            timeSince = time(NULL); //reset the time to before the joystick was handled
         }
     }
 
+    outputStop();
+    logStop();
+    printf("Injected %ld relative moves, %ld absolute moves, %ld clicks, %ld key events\n",
+           stats.relMoves, stats.absMoves, stats.buttons, stats.keys);
+    printf("Output backend latency: about %ld us per injection\n", atomic_load(&outputQueue.latencyUs));
+#if YDOTOOL_BACKEND
+    if(ydotool.batches > 0)
+    {
+        printf("Sent %ld input events to ydotoold in %ld batches\n", ydotool.sent, ydotool.batches);
+    }
+#endif
+    long gestureCount = 0;
+    for(int i = 0; i < GESTURES; i++)
+    {
+        gestureCount += stats.gestures[i];
+    }
+    printf("Recognized %ld taps, %ld double-taps, %ld long-presses, %ld repeats\n",
+           stats.gestures[GESTURE_TAP], stats.gestures[GESTURE_DOUBLE_TAP],
+           stats.gestures[GESTURE_LONG_PRESS], stats.gestures[GESTURE_REPEAT]);
+    if(gestureCount > 0)
+    {
+        printf("Gesture recognition latency: %.2f ms on average, %lld ms at most\n",
+               (double) stats.recognitionMs / gestureCount, stats.recognitionMaxMs);
+    }
+    if(stats.reconnects > 0)
+    {
+        printf("Reconnected %ld times, %lld ms on average from the device reappearing to reading it\n",
+               stats.reconnects, stats.reconnectMs / stats.reconnects);
+    }
+
     //cleanup
-    close(js);
+#if MPX_BACKEND
+    mpxRemove();
+#endif
+#if X11_BACKEND
+    XCloseDisplay(display);
+#endif
+#if YDOTOOL_BACKEND
+    close(ydotool.fd);
+#endif
+    source.close(&source);
     free(axes);
     axes = NULL;
+    free(smoothAxes);
+    smoothAxes = NULL;
+    free(filters);
+    filters = NULL;
     return 0;
 }
 
@@ -334,27 +1074,27 @@ int main(int argc, char* argv[])
    handles events from the horizontal D-Pad
   
    @param int value: the state of the component
+   @param const struct profile* profile: supplies the keys to hold
    @return int 0 if a button is pressed, else -1
  */
-int handleDpadH(int value)
+int handleDpadH(int value, const struct profile* profile)
 {
-    if(value > D_PAD_DEADZ) //start pressing right
+    static int held = -1; //binding this axis holds down
+    int direction = dpadDirection(value, D_PAD_DEADZ);
+    if(direction > 0) //start pressing right
     {
-        printf("right\n");
-        system("xdotool keydown 114");
-        return 0;
+        logDebug("right\n");
+        return holdDpadKey(&held, keyIndex(profile, DPAD_RIGHT));
     }
-    else if(value > -D_PAD_DEADZ) //stop pressing both
+    else if(0 == direction) //stop pressing both
     {
-        printf("stop dpad horizontal\n");
-        system("xdotool keyup 114 keyup 113");
-        return -1;
+        logDebug("stop dpad horizontal\n");
+        return holdDpadKey(&held, -1);
     }
     else //start pressing left
     {
-        printf("left\n");
-        system("xdotool keydown 113");
-        return 0;
+        logDebug("left\n");
+        return holdDpadKey(&held, keyIndex(profile, DPAD_LEFT));
     }
 }
 
@@ -362,49 +1102,189 @@ int handleDpadH(int value)
    handles events from the vertical D-Pad
   
    @param int value: the state of the component
-   @return int 0 if action goes through, else -1
+   @param const struct profile* profile: supplies the keys to hold
+   @return int 0 if a button is pressed, else -1
  */
-int handleDpadV(int value)
+int handleDpadV(int value, const struct profile* profile)
 {
-    if(value > D_PAD_DEADZ) //start pressing down
+    static int held = -1; //binding this axis holds down
+    int direction = dpadDirection(value, D_PAD_DEADZ);
+    if(direction > 0) //start pressing down
     {
-        printf("down\n");
-        system("xdotool keydown 116");
-        return 0;
+        logDebug("down\n");
+        return holdDpadKey(&held, keyIndex(profile, DPAD_DOWN));
     }
-    else if(value > -D_PAD_DEADZ) //stop pressing both
+    else if(0 == direction) //stop pressing both
     {
-        printf("stop dpad vertical\n");
-        system("xdotool keyup 116 keyup 111");
-        return -1;
+        logDebug("stop dpad vertical\n");
+        return holdDpadKey(&held, -1);
     }
     else //start pressing up
     {
-        printf("up\n");
-        system("xdotool keydown 111");
-        return 0;
+        logDebug("up\n");
+        return holdDpadKey(&held, keyIndex(profile, DPAD_UP));
     }
 }
 
 /*
-   handles the horizontal right stick events.
-   Checks the array size stored in axes_len to ensure there
-   is no overflow from accessing indexes hAxisNum or vAxisNum.
-   Pulls the horizonal andd vertical axis values from the passed
-   array.
-   Returns the system time to be used in book-keeping when the last event went through
+   makes a D-pad axis hold a binding, releasing the binding it held before.
+   Remembering the held binding means a profile switch mid-press still releases
+   the right keys, and repeats of the same state inject nothing.
   
-   @param int* axes the head of an array of axis values
-   @param int axes_len the length of the axes array
-   @param int hAxisNum the number of the horizontal axis
+   @param int* held the key table index the axis holds, -1 for none; updated to key
+   @param int key the key table index to hold, -1 to release
+   @return int 0 if a key is held afterwards, else -1
+ */
+int holdDpadKey(int* held, int key)
+{
+    if(*held != key)
+    {
+        queueOutput(OUTPUT_KEYS, *held, key);
+        *held = key;
+    }
+    return (key >= 0) ? 0 : -1;
+}
+
+/*
+   @param const struct profile* profile an entry of profiles[]
+   @param enum dpadKey key the D-pad direction
+   @return int where the profile's binding for key sits in the key table
+ */
+int keyIndex(const struct profile* profile, enum dpadKey key)
+{
+    return (int) (profile - profiles) * DPAD_KEYS + key;
+}
+
+/*
+   rebuilds the key table from the bindings in profiles[].
+   With a display, each binding is split on '+' and every part is resolved to a
+   keycode with the current keymap; the last part is the key, the rest are
+   modifiers. ctrl, shift, alt and super stand for their left-hand keys.
+   The ydotool build resolves the same way to evdev key codes, without a display.
+   Called at startup and again whenever the keymap changes (MappingNotify).
+   The table is built aside and copied in whole, so an injection never sees half of it.
+  
+   @param void* keyDisplay the Display* to resolve with, or NULL to leave names for xdotool
+ */
+void resolveBindings(void* keyDisplay)
+{
+    struct keyBinding table[PROFILE_COUNT * DPAD_KEYS];
+
+    for(unsigned int i = 0; i < PROFILE_COUNT * DPAD_KEYS; i++)
+    {
+        struct keyBinding* binding = &table[i];
+        memset(binding, 0, sizeof(*binding));
+        binding->name = profiles[i / DPAD_KEYS].keys[i % DPAD_KEYS];
+#if X11_BACKEND || YDOTOOL_BACKEND
+#if X11_BACKEND
+        if(NULL == keyDisplay)
+        {
+            continue;
+        }
+#endif
+
+        char parts[BINDING_LEN];
+        strncpy(parts, binding->name, BINDING_LEN - 1);
+        parts[BINDING_LEN - 1] = '\0';
+        char* save = NULL;
+        for(char* part = strtok_r(parts, "+", &save); NULL != part; part = strtok_r(NULL, "+", &save))
+        {
+            const char* keysymName = part;
+            if(0 == strcasecmp(part, "ctrl"))
+            {
+                keysymName = "Control_L";
+            }
+            else if(0 == strcasecmp(part, "shift"))
+            {
+                keysymName = "Shift_L";
+            }
+            else if(0 == strcasecmp(part, "alt"))
+            {
+                keysymName = "Alt_L";
+            }
+            else if(0 == strcasecmp(part, "super"))
+            {
+                keysymName = "Super_L";
+            }
+
+#if X11_BACKEND
+            KeySym keysym = XStringToKeysym(keysymName);
+            int keycode = (NoSymbol == keysym) ? 0 : XKeysymToKeycode((Display*) keyDisplay, keysym);
+#else
+            int keycode = ydotoolKeycode(keysymName);
+#endif
+            if(0 == keycode)
+            {
+                logWarn("Warning: binding [%s]: no key for [%s] on this keymap\n", binding->name, part);
+                binding->keycode = -1;
+                break;
+            }
+
+            //the previous part was a modifier after all
+            if(0 != binding->keycode)
+            {
+                if(MAX_MODIFIERS == binding->modifierCount)
+                {
+                    logWarn("Warning: binding [%s] has too many modifiers\n", binding->name);
+                    binding->keycode = -1;
+                    break;
+                }
+                binding->modifiers[binding->modifierCount++] = binding->keycode;
+            }
+            binding->keycode = keycode;
+        }
+#endif
+    }
+
+    pthread_mutex_lock(&keyTableLock);
+    memcpy(keyTable, table, sizeof(keyTable));
+    pthread_mutex_unlock(&keyTableLock);
+}
+
+/*
+   copies one binding out of the key table, so a rebuild can't change it mid-injection
+  
+   @param int index the key table index, or -1 for none
+   @param struct keyBinding* copy where to put the binding
+   @return const struct keyBinding* copy, or NULL if index is -1
+ */
+const struct keyBinding* loadBinding(int index, struct keyBinding* copy)
+{
+    if(index < 0)
+    {
+        return NULL;
+    }
+    pthread_mutex_lock(&keyTableLock);
+    *copy = keyTable[index];
+    pthread_mutex_unlock(&keyTableLock);
+    return copy;
+}
+
+/*
+   handles the horizontal right stick events.
+   Checks the array size stored in axes_len to ensure there
+   is no overflow from accessing indexes hAxisNum or vAxisNum.
+   Pulls the horizonal andd vertical axis values from the passed
+   array and moves the cursor by their stickNudge() values.
+   The fraction of a pixel left over is carried to the next call, so a
+   slow stick or a large divisor still moves, just less often.
+  
+   @param int* axes the head of an array of axis values
+   @param int axes_len the length of the axes array
+   @param int hAxisNum the number of the horizontal axis
    @param int vAxisNum the number of the vertical axis
    @param int deadZone the upper limit value of the deadzone
+   @param int divisor the deflection per pixel of nudge
    @return -1 if hAxisNum or vAxisNum outside of axes, 
-           0 if the values are outside deadzone range,
-           1 otherwise
+           0 if both values are inside the deadzone (the stick is at rest),
+           1 if the stick is nudging the cursor
 */
-int handleStick(const int* axes, int axes_len, int hAxisNum, int vAxisNum, int deadZone)
+int handleStick(const int* axes, int axes_len, int hAxisNum, int vAxisNum, int deadZone, int divisor)
 {
+    //subpixels not moved yet
+    static int carryH = 0;
+    static int carryV = 0;
+
     //if indexes out of bounds, fail
     if(hAxisNum >= axes_len || vAxisNum >= axes_len)
     {
@@ -414,51 +1294,2029 @@ int handleStick(const int* axes, int axes_len, int hAxisNum, int vAxisNum, int d
     int hValue = axes[hAxisNum]; //the deflection value of the horizontal stick
     int vValue = axes[vAxisNum]; //the deflection value of the vertical stick
 
-#if DEBUG
-    printf("hValue: %d\nvValue: %d\n", hValue, vValue);
-#endif
+    logDebug("hValue: %d, vValue: %d\n", hValue, vValue);
 
     int nudgeH = 0;
     int nudgeV = 0;
 
-    //calculate nudge values, checking deadzones;
-    //horizontal
-    //if value is within the deadzone set the nudge value to 0
-    if(hValue < deadZone && hValue > -deadZone)
+    //calculate nudge values, checking deadzones
+    nudgeH = stickNudge(hValue, deadZone, divisor);
+    nudgeV = stickNudge(vValue, deadZone, divisor);
+
+    logDebug("nudgeH: %d, nudgeV: %d\n", nudgeH, nudgeV);
+
+    //if nonzero nudges, do something
+    if(0 != nudgeH || 0 != nudgeV)
     {
-        nudgeH = 0;
+        //whole pixels go out now, the rest waits for the next call (division truncates towards zero)
+        carryH += nudgeH;
+        carryV += nudgeV;
+        int dx = carryH / NUDGE_SUBPIXELS;
+        int dy = carryV / NUDGE_SUBPIXELS;
+        carryH -= dx * NUDGE_SUBPIXELS;
+        carryV -= dy * NUDGE_SUBPIXELS;
+        if(0 != dx || 0 != dy)
+        {
+            movePointerRel(dx, dy);
+        }
+        return 1; //return success code
     }
-    else
+    //the stick is at rest: motion that hasn't gone out yet is dropped so the cursor stops now
+    carryH = 0;
+    carryV = 0;
+    cancelMotion();
+    return 0;
+}
+
+/*
+   lets go of everything the controller was doing: releases D-pad keys, centers
+   the axes, drops queued motion and forgets button gestures. Used when the
+   device or virtual controller goes away, so nothing stays held or keeps moving.
+  
+   @param const struct profile* profile the active profile
+   @param int* axes the axis values, axisCount long
+   @param int* smoothAxes the smoothed axis values, axisCount long
+   @param struct oneEuro* filters the filter state, axisCount long
+   @param int axisCount the number of axes
+*/
+void releaseController(const struct profile* profile, int* axes, int* smoothAxes, struct oneEuro* filters, int axisCount)
+{
+    handleDpadH(0, profile);
+    handleDpadV(0, profile);
+    memset(axes, 0, axisCount * sizeof(int));
+    memset(smoothAxes, 0, axisCount * sizeof(int));
+    memset(filters, 0, axisCount * sizeof(struct oneEuro));
+    cancelMotion();
+    gestureReset();
+}
+
+/*
+   handles the stick in absolute and hybrid pointer modes.
+   Deflection past flickZone places the cursor at the matching point of the
+   ABS_REGION_* rectangle (full left/up is the left/top edge, center is the middle),
+   so crossing the desktop takes a single injected event instead of a stream of nudges.
+   Deflection between deadZone and flickZone falls through to handleStick() for
+   fine relative movement. Passing flickZone == deadZone gives pure absolute mode.
+   A target is only injected when it differs from the last one placed.
+  
+   @param int* axes the head of an array of axis values
+   @param int axes_len the length of the axes array
+   @param int hAxisNum the number of the horizontal axis
+   @param int vAxisNum the number of the vertical axis
+   @param int deadZone the upper limit value of the deadzone
+   @param int flickZone the deflection past which the cursor is placed absolutely
+   @param int divisor the deflection per pixel of nudge below flickZone
+   @return -1 if hAxisNum or vAxisNum outside of axes, 
+           0 if the values are inside the deadzone or the cursor is already on target,
+           1 otherwise
+*/
+int handleStickAbs(const int* axes, int axes_len, int hAxisNum, int vAxisNum, int deadZone, int flickZone, int divisor)
+{
+    //last target placed; -1 forces the next flick through
+    static int lastX = -1;
+    static int lastY = -1;
+
+    //if indexes out of bounds, fail
+    if(hAxisNum >= axes_len || vAxisNum >= axes_len)
     {
-//         nudgeH = hValue/abs(hValue); //test
-        nudgeH = hValue / 10000;
+        return -1;
     }
 
-    //vertical
-    //if value is within the deadzone set the nudge value to 0
-    if(vValue < deadZone && vValue > -deadZone)
+    int hValue = axes[hAxisNum];
+    int vValue = axes[vAxisNum];
+
+    //below the flick zone the stick is a normal relative stick
+    if(abs(hValue) < flickZone && abs(vValue) < flickZone)
     {
-        nudgeV = 0;
+        lastX = -1; //the next flick always lands, even on the previous target
+        lastY = -1;
+        return handleStick(axes, axes_len, hAxisNum, vAxisNum, deadZone, divisor);
     }
-    else
+
+    int x = stickTarget(hValue, ABS_REGION_X, ABS_REGION_W);
+    int y = stickTarget(vValue, ABS_REGION_Y, ABS_REGION_H);
+
+    logDebug("absolute target: %d, %d\n", x, y);
+
+    if(x == lastX && y == lastY)
     {
-//         nudgeV = vValue/abs(vValue); //test
-        nudgeV = vValue / 10000;
+        return 0;
     }
+    lastX = x;
+    lastY = y;
+    movePointerAbs(x, y);
+    return 1;
+}
 
-#if DEBUG
-    printf("nudgeH: %d\nnudgeV: %d\n", nudgeH, nudgeV);
+/*
+   moves the pointer by (dx, dy) pixels from where it is
+  
+   @param int dx the horizontal distance; positive is right
+   @param int dy the vertical distance; positive is down
+   @return int 0; the move is queued
+*/
+int movePointerRel(int dx, int dy)
+{
+    queueOutput(OUTPUT_REL, dx, dy);
+    return 0;
+}
+
+/*
+   moves the pointer to (x, y) on the screen
+  
+   @param int x the horizontal screen coordinate
+   @param int y the vertical screen coordinate
+   @return int 0; the move is queued
+*/
+int movePointerAbs(int x, int y)
+{
+    queueOutput(OUTPUT_ABS, x, y);
+    return 0;
+}
+
+/*
+   clicks a mouse button
+  
+   @param int button one of the CLICK_* or SCROLL_* constants
+   @return int 0; the click is queued
+*/
+int pressButton(int button)
+{
+    queueOutput(OUTPUT_CLICK, button, 0);
+    return 0;
+}
+
+/*
+   starts the output thread; call before anything is injected
+*/
+void outputStart(void)
+{
+    outputQueue.running = true;
+    atomic_init(&outputQueue.latencyUs, 0);
+    if(0 != pthread_create(&outputQueue.thread, NULL, outputThread, NULL))
+    {
+        //without the thread, queueOutput() injects directly
+        printf("Warning: failed to start the output thread\n");
+        outputQueue.running = false;
+    }
+}
+
+/*
+   lets the output thread finish what is queued, then stops it
+*/
+void outputStop(void)
+{
+    pthread_mutex_lock(&outputQueue.lock);
+    bool wasRunning = outputQueue.running;
+    outputQueue.running = false;
+    pthread_cond_signal(&outputQueue.ready);
+    pthread_mutex_unlock(&outputQueue.lock);
+    if(wasRunning)
+    {
+        pthread_join(outputQueue.thread, NULL);
+    }
+}
+
+/*
+   queues an injection for the output thread.
+   Motion merges into the newest queued command when that is also motion:
+   relative moves add up, an absolute move replaces whatever motion is there,
+   and a relative move after an absolute one shifts its target. So however far
+   the backend falls behind, at most one motion command waits at the tail, and
+   motion goes out only as fast as the backend takes it while keeping its speed.
+   Clicks and keys always get their own slot, in order; if the queue is full
+   the event loop waits rather than drop them.
+  
+   @param enum outputKind kind what to inject
+   @param int a the first argument; see enum outputKind
+   @param int b the second argument; see enum outputKind
+*/
+void queueOutput(enum outputKind kind, int a, int b)
+{
+    struct outputCommand command = {kind, a, b};
+
+    pthread_mutex_lock(&outputQueue.lock);
+    if(!outputQueue.running) //no thread; inject in place
+    {
+        pthread_mutex_unlock(&outputQueue.lock);
+        inject(&command);
+#if X11_BACKEND
+        XFlush(display);
+#elif YDOTOOL_BACKEND
+        ydotoolFlush();
 #endif
+        return;
+    }
 
-    //if nonzero nudges, do something
-    if(0 != nudgeH || 0 != nudgeV)
+    if(outputQueue.count > 0 && (OUTPUT_REL == kind || OUTPUT_ABS == kind))
     {
-        //build command
-        char cmd[CMD_LEN];
-        sprintf(cmd, "xdotool mousemove_relative -- %d %d", nudgeH, nudgeV);
-        //run command
-        system(cmd);
-        return 1; //return success code
+        struct outputCommand* tail = &outputQueue.commands[(outputQueue.head + outputQueue.count - 1) % OUTPUT_QUEUE_SIZE];
+        if(OUTPUT_ABS == kind && (OUTPUT_REL == tail->kind || OUTPUT_ABS == tail->kind))
+        {
+            *tail = command;
+            pthread_mutex_unlock(&outputQueue.lock);
+            return;
+        }
+        if(OUTPUT_REL == kind && (OUTPUT_REL == tail->kind || OUTPUT_ABS == tail->kind))
+        {
+            tail->a += a;
+            tail->b += b;
+            pthread_mutex_unlock(&outputQueue.lock);
+            return;
+        }
+    }
+
+    while(OUTPUT_QUEUE_SIZE == outputQueue.count)
+    {
+        pthread_cond_wait(&outputQueue.space, &outputQueue.lock);
+    }
+    outputQueue.commands[(outputQueue.head + outputQueue.count) % OUTPUT_QUEUE_SIZE] = command;
+    outputQueue.count++;
+    pthread_cond_signal(&outputQueue.ready);
+    pthread_mutex_unlock(&outputQueue.lock);
+}
+
+/*
+   drops relative motion still waiting at the tail of the queue.
+   At most the one injection already running moves the cursor after this.
+*/
+void cancelMotion(void)
+{
+    pthread_mutex_lock(&outputQueue.lock);
+    if(outputQueue.count > 0)
+    {
+        int tail = (outputQueue.head + outputQueue.count - 1) % OUTPUT_QUEUE_SIZE;
+        if(OUTPUT_REL == outputQueue.commands[tail].kind)
+        {
+            outputQueue.count--;
+            pthread_cond_signal(&outputQueue.space);
+        }
+    }
+    pthread_mutex_unlock(&outputQueue.lock);
+}
+
+/*
+   body of the output thread; injects queued commands in order and keeps
+   the latency estimate current. Nothing steers by the estimate: a slow backend
+   is absorbed by queueOutput() merging motion while the thread is busy.
+  
+   @param void* arg unused
+   @return void* always NULL
+*/
+void* outputThread(void* arg)
+{
+    pthread_mutex_lock(&outputQueue.lock);
+    for(;;)
+    {
+        while(0 == outputQueue.count && outputQueue.running)
+        {
+            pthread_cond_wait(&outputQueue.ready, &outputQueue.lock);
+        }
+        if(0 == outputQueue.count) //stopped and drained
+        {
+            break;
+        }
+        struct outputCommand command = outputQueue.commands[outputQueue.head];
+        outputQueue.head = (outputQueue.head + 1) % OUTPUT_QUEUE_SIZE;
+        outputQueue.count--;
+#if X11_BACKEND || YDOTOOL_BACKEND
+        bool drained = (0 == outputQueue.count); //taken under the lock; the event loop keeps queueing
+#endif
+        pthread_cond_signal(&outputQueue.space);
+        pthread_mutex_unlock(&outputQueue.lock);
+
+        struct timespec start;
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        inject(&command);
+#if X11_BACKEND
+        //in-process injections go out together once the queue is drained,
+        //so a burst costs one round of X traffic however many commands or pointers it holds
+        if(drained)
+        {
+            XFlush(display);
+        }
+#elif YDOTOOL_BACKEND
+        //likewise, ydotoold gets a burst as one sendmmsg()
+        if(drained)
+        {
+            ydotoolFlush();
+        }
+#endif
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        long sampleUs = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000;
+        long latencyUs = atomic_load_explicit(&outputQueue.latencyUs, memory_order_relaxed);
+        atomic_store_explicit(&outputQueue.latencyUs, latencyUs + (sampleUs - latencyUs) / OUTPUT_LATENCY_WEIGHT,
+                              memory_order_relaxed);
+
+        pthread_mutex_lock(&outputQueue.lock);
+    }
+    pthread_mutex_unlock(&outputQueue.lock);
+    return NULL;
+}
+
+/*
+   performs one injection with the configured backend.
+   In-process X and ydotool injections are only buffered here; the output thread flushes them.
+  
+   @param const struct outputCommand* command what to inject
+   @return int 0 on success, else -1
+*/
+int inject(const struct outputCommand* command)
+{
+#if MPX_BACKEND
+    if(mpx.active)
+    {
+        switch(command->kind)
+        {
+            case OUTPUT_REL:
+                stats.relMoves++;
+                XIWarpPointer(display, mpx.pointer, None, None, 0, 0, 0, 0, command->a, command->b);
+                break;
+            case OUTPUT_ABS:
+                stats.absMoves++;
+                XIWarpPointer(display, mpx.pointer, None, DefaultRootWindow(display), 0, 0, 0, 0,
+                              command->a, command->b);
+                break;
+            case OUTPUT_CLICK:
+                stats.buttons++;
+                XTestFakeDeviceButtonEvent(display, mpx.fakePointer, command->a, True, NULL, 0, CurrentTime);
+                XTestFakeDeviceButtonEvent(display, mpx.fakePointer, command->a, False, NULL, 0, CurrentTime);
+                break;
+            case OUTPUT_KEYS:
+            {
+                struct keyBinding releaseCopy;
+                struct keyBinding pressCopy;
+                const struct keyBinding* release = loadBinding(command->a, &releaseCopy);
+                const struct keyBinding* press = loadBinding(command->b, &pressCopy);
+                if(NULL != release && release->keycode > 0)
+                {
+                    stats.keys++;
+                    XTestFakeDeviceKeyEvent(display, mpx.fakeKeyboard, release->keycode, False, NULL, 0, CurrentTime);
+                    for(int i = release->modifierCount - 1; i >= 0; i--)
+                    {
+                        XTestFakeDeviceKeyEvent(display, mpx.fakeKeyboard, release->modifiers[i], False, NULL, 0, CurrentTime);
+                    }
+                }
+                if(NULL != press && press->keycode > 0)
+                {
+                    stats.keys++;
+                    for(int i = 0; i < press->modifierCount; i++)
+                    {
+                        XTestFakeDeviceKeyEvent(display, mpx.fakeKeyboard, press->modifiers[i], True, NULL, 0, CurrentTime);
+                    }
+                    XTestFakeDeviceKeyEvent(display, mpx.fakeKeyboard, press->keycode, True, NULL, 0, CurrentTime);
+                }
+                break;
+            }
+        }
+        return 0;
+    }
+#endif
+
+#if YDOTOOL_BACKEND
+    switch(command->kind)
+    {
+        case OUTPUT_REL:
+            stats.relMoves++;
+            ydotoolEmit(EV_REL, REL_X, command->a);
+            ydotoolEmit(EV_REL, REL_Y, command->b);
+            ydotoolEmit(EV_SYN, SYN_REPORT, 0);
+            break;
+        case OUTPUT_ABS:
+            //ydotoold's device is relative only, so do what `ydotool mousemove --absolute` does:
+            //pin the pointer in the top left corner, then move out from there
+            stats.absMoves++;
+            ydotoolEmit(EV_REL, REL_X, -(ABS_REGION_X + ABS_REGION_W) * 2);
+            ydotoolEmit(EV_REL, REL_Y, -(ABS_REGION_Y + ABS_REGION_H) * 2);
+            ydotoolEmit(EV_SYN, SYN_REPORT, 0);
+            ydotoolEmit(EV_REL, REL_X, command->a);
+            ydotoolEmit(EV_REL, REL_Y, command->b);
+            ydotoolEmit(EV_SYN, SYN_REPORT, 0);
+            break;
+        case OUTPUT_CLICK:
+        {
+            //X button numbers: 1-3 are buttons, 4-7 are wheel steps
+            stats.buttons++;
+            static const int buttons[] = {0, BTN_LEFT, BTN_MIDDLE, BTN_RIGHT};
+            static const int wheelSteps[] = {0, 0, 0, 0, 1, -1, -1, 1};
+            if(command->a >= CLICK_L && command->a <= CLICK_R)
+            {
+                ydotoolEmit(EV_KEY, buttons[command->a], 1);
+                ydotoolEmit(EV_SYN, SYN_REPORT, 0);
+                ydotoolEmit(EV_KEY, buttons[command->a], 0);
+                ydotoolEmit(EV_SYN, SYN_REPORT, 0);
+            }
+            else if(command->a >= SCROLL_U && command->a <= 7)
+            {
+                ydotoolEmit(EV_REL, (command->a <= SCROLL_D) ? REL_WHEEL : REL_HWHEEL, wheelSteps[command->a]);
+                ydotoolEmit(EV_SYN, SYN_REPORT, 0);
+            }
+            else
+            {
+                return -1;
+            }
+            break;
+        }
+        case OUTPUT_KEYS:
+        {
+            struct keyBinding releaseCopy;
+            struct keyBinding pressCopy;
+            const struct keyBinding* release = loadBinding(command->a, &releaseCopy);
+            const struct keyBinding* press = loadBinding(command->b, &pressCopy);
+            if(NULL != release && release->keycode > 0)
+            {
+                stats.keys++;
+                ydotoolEmit(EV_KEY, release->keycode, 0);
+                for(int i = release->modifierCount - 1; i >= 0; i--)
+                {
+                    ydotoolEmit(EV_KEY, release->modifiers[i], 0);
+                }
+                ydotoolEmit(EV_SYN, SYN_REPORT, 0);
+            }
+            if(NULL != press && press->keycode > 0)
+            {
+                stats.keys++;
+                for(int i = 0; i < press->modifierCount; i++)
+                {
+                    ydotoolEmit(EV_KEY, press->modifiers[i], 1);
+                }
+                ydotoolEmit(EV_KEY, press->keycode, 1);
+                ydotoolEmit(EV_SYN, SYN_REPORT, 0);
+            }
+            break;
+        }
     }
     return 0;
+#endif
+
+    char cmd[CMD_LEN];
+    switch(command->kind)
+    {
+        case OUTPUT_REL:
+            stats.relMoves++;
+#if X11_BACKEND
+            XWarpPointer(display, None, None, 0, 0, 0, 0, command->a, command->b);
+            return 0;
+#else
+            sprintf(cmd, "xdotool mousemove_relative -- %d %d", command->a, command->b);
+            break;
+#endif
+        case OUTPUT_ABS:
+            stats.absMoves++;
+#if X11_BACKEND
+            XWarpPointer(display, None, DefaultRootWindow(display), 0, 0, 0, 0, command->a, command->b);
+            return 0;
+#else
+            sprintf(cmd, "xdotool mousemove -- %d %d", command->a, command->b);
+            break;
+#endif
+        case OUTPUT_CLICK:
+            stats.buttons++;
+#if X11_BACKEND
+            XTestFakeButtonEvent(display, command->a, True, CurrentTime);
+            XTestFakeButtonEvent(display, command->a, False, CurrentTime);
+            return 0;
+#else
+            sprintf(cmd, "xdotool click %d", command->a);
+            break;
+#endif
+        case OUTPUT_KEYS:
+        {
+            struct keyBinding releaseCopy;
+            struct keyBinding pressCopy;
+            const struct keyBinding* release = loadBinding(command->a, &releaseCopy);
+            const struct keyBinding* press = loadBinding(command->b, &pressCopy);
+#if X11_BACKEND
+            //the keycodes were resolved up front, so a press is the table read and two requests
+            if(NULL != release && release->keycode > 0)
+            {
+                stats.keys++;
+                XTestFakeKeyEvent(display, release->keycode, False, CurrentTime);
+                for(int i = release->modifierCount - 1; i >= 0; i--)
+                {
+                    XTestFakeKeyEvent(display, release->modifiers[i], False, CurrentTime);
+                }
+            }
+            if(NULL != press && press->keycode > 0)
+            {
+                stats.keys++;
+                for(int i = 0; i < press->modifierCount; i++)
+                {
+                    XTestFakeKeyEvent(display, press->modifiers[i], True, CurrentTime);
+                }
+                XTestFakeKeyEvent(display, press->keycode, True, CurrentTime);
+            }
+            return 0;
+#else
+            //without X the names go to xdotool, which looks them up itself
+            strcpy(cmd, "xdotool");
+            if(NULL != release)
+            {
+                stats.keys++;
+                snprintf(cmd + strlen(cmd), CMD_LEN - strlen(cmd), " keyup %s", release->name);
+            }
+            if(NULL != press)
+            {
+                stats.keys++;
+                snprintf(cmd + strlen(cmd), CMD_LEN - strlen(cmd), " keydown %s", press->name);
+            }
+            if(0 == strcmp(cmd, "xdotool")) //neither binding maps to a key
+            {
+                return -1;
+            }
+            break;
+#endif
+        }
+        default:
+            return -1;
+    }
+    return 0 == system(cmd) ? 0 : -1;
 }
+
+/*
+   forgets every button's gesture and pending timer; used at startup and when the device goes away
+ */
+void gestureReset(void)
+{
+    memset(&gestures, 0, sizeof(gestures));
+    for(int i = 0; i < MAX_BUTTONS; i++)
+    {
+        gestures.buttons[i].heapIndex = -1;
+    }
+}
+
+/*
+   feeds a button press to the gesture engine.
+   A button with only a tap acts right away, as before gestures existed;
+   the others start a timer or wait for the release to tell gestures apart.
+   A button with no bindings is only tracked as held, and left out of the stats.
+  
+   @param int button the button number, below MAX_BUTTONS
+   @param unsigned int time the event time of the press in milliseconds
+   @return int 1 if the gesture asked to quit, else 0
+ */
+int gesturePress(int button, unsigned int time)
+{
+    struct buttonGesture* state = &gestures.buttons[button];
+    const struct gestureAction* actions = gestureActions[button];
+
+    gestureTimerCancel(button);
+    if(STAGE_TAPPED == state->stage) //second press inside the window
+    {
+        state->stage = STAGE_HELD;
+        return fireGesture(button, GESTURE_DOUBLE_TAP, time);
+    }
+    if(ACTION_NONE != actions[GESTURE_REPEAT].kind)
+    {
+        state->stage = STAGE_HELD;
+        gestureTimerSet(button, time + REPEAT_DELAY_MS);
+        return fireGesture(button, GESTURE_REPEAT, time);
+    }
+    if(ACTION_NONE != actions[GESTURE_LONG_PRESS].kind)
+    {
+        state->stage = STAGE_PRESSED;
+        gestureTimerSet(button, time + LONG_PRESS_MS);
+        return 0;
+    }
+    if(ACTION_NONE != actions[GESTURE_DOUBLE_TAP].kind)
+    {
+        state->stage = STAGE_PRESSED;
+        return 0;
+    }
+    state->stage = STAGE_HELD;
+    if(ACTION_NONE == actions[GESTURE_TAP].kind) //nothing bound at all; not a gesture, so nothing is counted
+    {
+        return 0;
+    }
+    return fireGesture(button, GESTURE_TAP, time);
+}
+
+/*
+   feeds a button release to the gesture engine
+  
+   @param int button the button number, below MAX_BUTTONS
+   @param unsigned int time the event time of the release in milliseconds
+   @return int 1 if the gesture asked to quit, else 0
+ */
+int gestureRelease(int button, unsigned int time)
+{
+    struct buttonGesture* state = &gestures.buttons[button];
+
+    gestureTimerCancel(button);
+    if(STAGE_PRESSED != state->stage) //already acted on, or a release without a press
+    {
+        state->stage = STAGE_IDLE;
+        return 0;
+    }
+    if(ACTION_NONE != gestureActions[button][GESTURE_DOUBLE_TAP].kind)
+    {
+        state->stage = STAGE_TAPPED;
+        gestureTimerSet(button, time + DOUBLE_TAP_MS);
+        return 0;
+    }
+    state->stage = STAGE_IDLE;
+    return fireGesture(button, GESTURE_TAP, time);
+}
+
+/*
+   fires every gesture timer due by now, earliest first.
+   A repeat that fell behind catches up, but by no more than REPEAT_CATCH_UP repeats,
+   so a stalled loop doesn't come back to a flood of them.
+  
+   @param unsigned int now the event time to expire up to
+   @return int 1 if a gesture asked to quit, else 0
+ */
+int gestureExpire(unsigned int now)
+{
+    int quit = 0;
+    while(gestures.timerCount > 0)
+    {
+        int button = gestures.timers[0];
+        struct buttonGesture* state = &gestures.buttons[button];
+        unsigned int deadline = state->deadline;
+        if((int) (deadline - now) > 0)
+        {
+            break;
+        }
+
+        gestureTimerCancel(button);
+        switch(state->stage)
+        {
+            case STAGE_PRESSED: //held long enough
+                state->stage = STAGE_HELD;
+                quit |= fireGesture(button, GESTURE_LONG_PRESS, deadline);
+                break;
+            case STAGE_HELD: //only repeating buttons keep a timer while held
+                if((int) (now - deadline) > REPEAT_CATCH_UP * REPEAT_MS)
+                {
+                    deadline = now - REPEAT_CATCH_UP * REPEAT_MS;
+                }
+                gestureTimerSet(button, deadline + REPEAT_MS);
+                quit |= fireGesture(button, GESTURE_REPEAT, deadline);
+                break;
+            case STAGE_TAPPED: //no second tap came
+                state->stage = STAGE_IDLE;
+                quit |= fireGesture(button, GESTURE_TAP, deadline);
+                break;
+            case STAGE_IDLE:
+                break;
+        }
+    }
+    return quit;
+}
+
+/*
+   @return int milliseconds until the next gesture timer is due (0 if overdue), or -1 if none is pending
+ */
+int gestureWaitMs(void)
+{
+    if(0 == gestures.timerCount)
+    {
+        return -1;
+    }
+    int waitMs = (int) (gestures.buttons[gestures.timers[0]].deadline - eventClockNow());
+    return (waitMs < 0) ? 0 : waitMs;
+}
+
+/*
+   @return bool true if any button is down or waiting on a timer
+ */
+bool gestureActive(void)
+{
+    if(gestures.timerCount > 0)
+    {
+        return true;
+    }
+    for(int i = 0; i < MAX_BUTTONS; i++)
+    {
+        if(STAGE_IDLE != gestures.buttons[i].stage)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+   runs the action bound to a recognized gesture and records how long recognizing it took
+  
+   @param int button the button number
+   @param enum gesture gesture the gesture recognized
+   @param unsigned int decidedAt the event time that settled it: the deciding event or the deadline
+   @return int 1 if the action is to quit, else 0
+ */
+int fireGesture(int button, enum gesture gesture, unsigned int decidedAt)
+{
+    int latencyMs = (int) (eventClockNow() - decidedAt);
+    if(latencyMs < 0)
+    {
+        latencyMs = 0;
+    }
+    stats.gestures[gesture]++;
+    stats.recognitionMs += latencyMs;
+    if(latencyMs > stats.recognitionMaxMs)
+    {
+        stats.recognitionMaxMs = latencyMs;
+    }
+
+    const struct gestureAction* action = &gestureActions[button][gesture];
+    logDebug("button %d: %s\n", button, gestureNames[gesture]);
+    switch(action->kind)
+    {
+        case ACTION_CLICK:
+            pressButton(action->argument);
+            return 0;
+        case ACTION_QUIT:
+            logInfo("quit!\n");
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/*
+   learns how event time lines up with nowMs().
+   Event time is the device's clock (jiffies for js devices, whatever the client sends
+   over a socket), so it's mapped onto ours through the smallest gap seen between an
+   event's time and its arrival: the event that was read the soonest.
+   All the arithmetic is modulo 2^32, like event time itself.
+  
+   @param unsigned int time the event time of an event just read
+ */
+void syncEventClock(unsigned int time)
+{
+    unsigned int offset = (unsigned int) nowMs() - time;
+    if(!gestures.clockKnown || (int) (offset - gestures.clockOffset) < 0)
+    {
+        gestures.clockOffset = offset;
+        gestures.clockKnown = true;
+    }
+}
+
+/*
+   @return unsigned int the current time on the event clock, in milliseconds
+ */
+unsigned int eventClockNow(void)
+{
+    return (unsigned int) nowMs() - gestures.clockOffset;
+}
+
+/*
+   sets or moves a button's timer
+  
+   @param int button the button number
+   @param unsigned int deadline the event time it fires at
+ */
+void gestureTimerSet(int button, unsigned int deadline)
+{
+    struct buttonGesture* state = &gestures.buttons[button];
+    state->deadline = deadline;
+    if(state->heapIndex < 0)
+    {
+        state->heapIndex = gestures.timerCount;
+        gestures.timers[gestures.timerCount++] = button;
+    }
+    gestureTimerSift(state->heapIndex);
+}
+
+/*
+   removes a button's timer, if it has one
+  
+   @param int button the button number
+ */
+void gestureTimerCancel(int button)
+{
+    int index = gestures.buttons[button].heapIndex;
+    if(index < 0)
+    {
+        return;
+    }
+
+    //the last timer fills the hole and is sifted to its place
+    int last = --gestures.timerCount;
+    gestures.buttons[button].heapIndex = -1;
+    if(index != last)
+    {
+        gestures.timers[index] = gestures.timers[last];
+        gestures.buttons[gestures.timers[index]].heapIndex = index;
+        gestureTimerSift(index);
+    }
+}
+
+/*
+   moves the timer at index up or down the heap until its deadline is in order
+  
+   @param int index the heap slot whose deadline changed
+ */
+void gestureTimerSift(int index)
+{
+    int* timers = gestures.timers;
+    for(;;)
+    {
+        int earliest = index;
+        int parent = (index - 1) / 2;
+        int left = 2 * index + 1;
+        int right = left + 1;
+        if(index > 0 && (int) (gestures.buttons[timers[index]].deadline - gestures.buttons[timers[parent]].deadline) < 0)
+        {
+            earliest = parent;
+        }
+        else
+        {
+            if(left < gestures.timerCount
+               && (int) (gestures.buttons[timers[left]].deadline - gestures.buttons[timers[earliest]].deadline) < 0)
+            {
+                earliest = left;
+            }
+            if(right < gestures.timerCount
+               && (int) (gestures.buttons[timers[right]].deadline - gestures.buttons[timers[earliest]].deadline) < 0)
+            {
+                earliest = right;
+            }
+        }
+        if(earliest == index)
+        {
+            return;
+        }
+
+        int swap = timers[index];
+        timers[index] = timers[earliest];
+        timers[earliest] = swap;
+        gestures.buttons[timers[index]].heapIndex = index;
+        gestures.buttons[timers[earliest]].heapIndex = earliest;
+        index = earliest;
+    }
+}
+
+/*
+   runs one sample through a One-Euro filter: a low-pass filter whose cutoff
+   rises with the speed of the signal, so jitter on a still stick is smoothed
+   out while fast flicks pass with little lag.
+   The first sample primes the filter and passes through unchanged.
+  
+   @param struct oneEuro* filter the state of the axis being filtered
+   @param float value the raw sample
+   @param unsigned int time the event time of the sample in milliseconds
+   @param float minCutoff the cutoff frequency in Hz when the signal is still
+   @param float beta how much the cutoff rises per unit/second of speed
+   @return float the filtered sample
+*/
+float oneEuroFilter(struct oneEuro* filter, float value, unsigned int time, float minCutoff, float beta)
+{
+    if(!filter->primed)
+    {
+        filter->primed = true;
+        filter->value = value;
+        filter->speed = 0.0f;
+        filter->time = time;
+        return value;
+    }
+
+    //samples in the same millisecond still count as 1 ms apart
+    unsigned int dtMs = ((int) (time - filter->time) > 0) ? time - filter->time : 1;
+    filter->time = time;
+
+    //smoothing factor for cutoff frequency fc is dt / (dt + 1 / (2*pi*fc)), or 2*pi*fc / (2*pi*fc + rate);
+    //everything that only depends on dt is kept until dt changes
+    if(dtMs != filter->dtMs)
+    {
+        filter->dtMs = dtMs;
+        filter->rate = 1000.0f / dtMs;
+        filter->alphaD = 1.0f / (1.0f + FILTER_TAU_D * filter->rate);
+    }
+    float speed = (value - filter->value) * filter->rate;
+    filter->speed += filter->alphaD * (speed - filter->speed);
+
+    float omega = 6.2831853f * (minCutoff + beta * (filter->speed < 0 ? -filter->speed : filter->speed));
+    float alpha = omega / (omega + filter->rate);
+    filter->value += alpha * (value - filter->value);
+    return filter->value;
+}
+
+/*
+   runs one axis sample through its One-Euro filter for the F argument.
+   Once the filter is within FILTER_SETTLE of the sample it gives the sample
+   itself, so a held or released stick ends up exactly where it is.
+  
+   @param struct oneEuro* filter the state of the axis
+   @param int value the raw axis value
+   @param unsigned int time the event time of the sample in milliseconds
+   @return int the smoothed axis value
+*/
+int smoothAxis(struct oneEuro* filter, int value, unsigned int time)
+{
+    int smoothed = (int) oneEuroFilter(filter, value, time, FILTER_MIN_CUTOFF, FILTER_BETA);
+    return (abs(smoothed - value) <= FILTER_SETTLE) ? value : smoothed;
+}
+
+/*
+   gives the direction a D-pad axis is pressed in.
+   The deadzone is symmetric: values within [-deadZone, deadZone] are released.
+  
+   @param int value the state of the axis
+   @param int deadZone the upper limit value of the deadzone
+   @return int 1 if pressed towards positive (right/down),
+           -1 if pressed towards negative (left/up),
+           0 otherwise
+*/
+int dpadDirection(int value, int deadZone)
+{
+    if(value > deadZone)
+    {
+        return 1;
+    }
+    else if(value < -deadZone)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+   gives how far one stick axis moves the cursor per update, in 1/NUDGE_SUBPIXELS
+   of a pixel, so a large divisor scales the speed down without cutting off
+   small deflections. The result is 0 strictly inside the deadzone, never
+   decreases as value grows, and is odd-symmetric (stickNudge(-v) == -stickNudge(v))
+   since C division truncates towards zero.
+  
+   @param int value the deflection of the axis
+   @param int deadZone the upper limit value of the deadzone
+   @param int divisor the deflection per pixel of nudge
+   @return int the nudge in subpixels; positive is right/down
+*/
+int stickNudge(int value, int deadZone, int divisor)
+{
+    //if value is within the deadzone the nudge is 0
+    if(value < deadZone && value > -deadZone)
+    {
+        return 0;
+    }
+//     return value/abs(value); //test
+    return value * NUDGE_SUBPIXELS / divisor;
+}
+
+/*
+   gives the screen coordinate one stick axis points at in absolute mode.
+   [-STICK_MAX, STICK_MAX] maps onto [origin, origin + size - 1]; values outside it,
+   like the -32768 js axes can report, are clamped first. The result never decreases as
+   value grows, and mirrors around the middle of the span to within one pixel.
+  
+   @param int value the deflection of the axis
+   @param int origin the first coordinate of the span
+   @param int size the number of pixels in the span
+   @return int the coordinate
+*/
+int stickTarget(int value, int origin, int size)
+{
+    if(value < -STICK_MAX)
+    {
+        value = -STICK_MAX;
+    }
+    else if(value > STICK_MAX)
+    {
+        value = STICK_MAX;
+    }
+    return origin + (int) ((long) (value + STICK_MAX) * (size - 1) / (2 * STICK_MAX));
+}
+
+/*
+   starts the thread that moves log messages from the ring to stdout.
+   Call once before anything logs.
+*/
+void logStart(void)
+{
+    for(unsigned int i = 0; i < LOG_RING_SIZE; i++)
+    {
+        atomic_init(&logRing.records[i].seq, i);
+    }
+    atomic_init(&logRing.head, 0);
+    atomic_init(&logRing.tail, 0);
+    atomic_init(&logRing.dropped, 0);
+    atomic_init(&logRing.running, true);
+    atomic_init(&logRing.wakePending, false);
+    logRing.wakeFd = eventfd(0, EFD_CLOEXEC);
+    if(logRing.wakeFd < 0 || 0 != pthread_create(&logRing.thread, NULL, logThread, NULL))
+    {
+        //without the thread, messages only come out when logFlush() is called
+        printf("Warning: failed to start the log thread\n");
+        atomic_store(&logRing.running, false);
+    }
+}
+
+/*
+   stops the log thread and writes out whatever is still queued
+*/
+void logStop(void)
+{
+    if(atomic_exchange(&logRing.running, false))
+    {
+        eventfd_write(logRing.wakeFd, 1);
+        pthread_join(logRing.thread, NULL);
+    }
+    logFlush();
+    if(logRing.wakeFd >= 0)
+    {
+        close(logRing.wakeFd);
+        logRing.wakeFd = -1;
+    }
+}
+
+/*
+   formats a message into the next free ring slot without touching stdout.
+   If the ring is full the message is dropped and counted; the event loop
+   never waits on the log.
+   Slots are claimed with a compare-and-swap on head, so several threads may log.
+   A slot whose seq equals the claim position is free; seq is set one past the
+   position once the text is in, which tells the reader it is ready.
+   Only the first message after the log thread wakes pays for waking it again.
+  
+   @param const char* format a printf format string
+   @param ... the values for format
+*/
+void logWrite(const char* format, ...)
+{
+    unsigned int pos = atomic_load_explicit(&logRing.head, memory_order_relaxed);
+    struct logRecord* record;
+    for(;;)
+    {
+        record = &logRing.records[pos & (LOG_RING_SIZE - 1)];
+        unsigned int seq = atomic_load_explicit(&record->seq, memory_order_acquire);
+        int dif = (int) (seq - pos);
+        if(0 == dif)
+        {
+            if(atomic_compare_exchange_weak_explicit(&logRing.head, &pos, pos + 1,
+                                                     memory_order_relaxed, memory_order_relaxed))
+            {
+                break; //slot claimed
+            }
+        }
+        else if(dif < 0) //the reader hasn't emptied this slot yet; the ring is full
+        {
+            atomic_fetch_add_explicit(&logRing.dropped, 1, memory_order_relaxed);
+            return;
+        }
+        else //another writer got here first
+        {
+            pos = atomic_load_explicit(&logRing.head, memory_order_relaxed);
+        }
+    }
+
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(record->text, LOG_RECORD_LEN, format, args);
+    va_end(args);
+    record->len = (len < 0) ? 0 : (len >= LOG_RECORD_LEN ? LOG_RECORD_LEN - 1 : len);
+
+    atomic_store_explicit(&record->seq, pos + 1, memory_order_release);
+
+    //pairs with the fence in logThread(): either it sees this record or we see its wakePending reset
+    atomic_thread_fence(memory_order_seq_cst);
+    if(!atomic_exchange(&logRing.wakePending, true) && logRing.wakeFd >= 0)
+    {
+        eventfd_write(logRing.wakeFd, 1);
+    }
+}
+
+/*
+   writes every ready message in the ring to stdout, oldest first.
+   Callable from any thread; flushLock keeps it to one reader at a time,
+   so the main thread can flush ahead of a prompt while the log thread runs.
+*/
+void logFlush(void)
+{
+    pthread_mutex_lock(&logRing.flushLock);
+    unsigned int pos = atomic_load_explicit(&logRing.tail, memory_order_relaxed);
+    for(;;)
+    {
+        struct logRecord* record = &logRing.records[pos & (LOG_RING_SIZE - 1)];
+        if(atomic_load_explicit(&record->seq, memory_order_acquire) != pos + 1)
+        {
+            break; //nothing more is ready
+        }
+        fwrite(record->text, 1, record->len, stdout);
+        atomic_store_explicit(&record->seq, pos + LOG_RING_SIZE, memory_order_release);
+        pos++;
+    }
+    atomic_store_explicit(&logRing.tail, pos, memory_order_relaxed);
+
+    unsigned long dropped = atomic_exchange_explicit(&logRing.dropped, 0, memory_order_relaxed);
+    if(dropped > 0)
+    {
+        printf("(%lu log messages dropped)\n", dropped);
+    }
+    fflush(stdout);
+    pthread_mutex_unlock(&logRing.flushLock);
+}
+
+/*
+   body of the log thread; sleeps on wakeFd until something is logged, then
+   empties the ring, until logStop(). Nothing logged means no wakeups at all.
+  
+   @param void* arg unused
+   @return void* always NULL
+*/
+void* logThread(void* arg)
+{
+    while(atomic_load(&logRing.running))
+    {
+        eventfd_t wakes;
+        if(0 != eventfd_read(logRing.wakeFd, &wakes) && EINTR != errno)
+        {
+            break;
+        }
+        atomic_store(&logRing.wakePending, false);
+        atomic_thread_fence(memory_order_seq_cst);
+        logFlush();
+    }
+    return NULL;
+}
+
+#if X11_BACKEND
+/*
+   starts the thread that follows the focused window and swaps activeProfile.
+   If it can't start, the default profile stays in use.
+*/
+void startFocusThread(void)
+{
+    pthread_t thread;
+    if(0 != pthread_create(&thread, NULL, focusThread, NULL))
+    {
+        logWarn("Warning: failed to start the focus thread; using the default profile\n");
+        return;
+    }
+    pthread_detach(thread); //runs until the program exits
+}
+
+/*
+   body of the focus thread.
+   Uses its own X connection and sleeps in XNextEvent until the window manager
+   changes _NET_ACTIVE_WINDOW on the root window, so nothing is polled and the
+   event loop only ever sees the result: one pointer store into activeProfile.
+   It also rebuilds the key table when the keymap changes.
+   Profiles are cached for the last PROFILE_CACHE_SIZE windows, so refocusing one
+   of them costs no round trip; a cached window is forgotten when it is destroyed.
+  
+   @param void* arg unused
+   @return void* NULL if the display or window manager can't be used
+*/
+void* focusThread(void* arg)
+{
+    Display* focusDisplay = XOpenDisplay(NULL);
+    if(NULL == focusDisplay)
+    {
+        logWarn("Warning: focus thread failed to open X display\n");
+        return NULL;
+    }
+    Window root = DefaultRootWindow(focusDisplay);
+    Atom activeAtom = XInternAtom(focusDisplay, "_NET_ACTIVE_WINDOW", True);
+    if(None == activeAtom)
+    {
+        //keep running anyway, to hear about keymap changes
+        logWarn("Warning: window manager doesn't publish _NET_ACTIVE_WINDOW; using the default profile\n");
+    }
+    else
+    {
+        XSelectInput(focusDisplay, root, PropertyChangeMask);
+    }
+
+    Window lastWindow = None;
+    struct profileCache cache = {0};
+    bool changed = (None != activeAtom); //look up whatever is focused at startup
+    for(;;)
+    {
+        if(changed)
+        {
+            Atom type;
+            int format;
+            unsigned long count;
+            unsigned long remaining;
+            unsigned char* data = NULL;
+            Window window = None;
+            if(Success == XGetWindowProperty(focusDisplay, root, activeAtom, 0, 1, False, XA_WINDOW,
+                                             &type, &format, &count, &remaining, &data)
+               && NULL != data && count > 0)
+            {
+                window = *(Window*) data;
+            }
+            if(NULL != data)
+            {
+                XFree(data);
+            }
+
+            if(window != lastWindow)
+            {
+                lastWindow = window;
+                const struct profile* profile = cachedProfile(&cache, focusDisplay, window);
+                if(atomic_exchange_explicit(&activeProfile, profile, memory_order_acq_rel) != profile)
+                {
+                    logInfo("Using profile [%s]\n", NULL == profile->windowClass ? "default" : profile->windowClass);
+                }
+            }
+        }
+
+        XEvent xEvent;
+        XNextEvent(focusDisplay, &xEvent);
+        changed = (None != activeAtom && PropertyNotify == xEvent.type && activeAtom == xEvent.xproperty.atom);
+
+        //a destroyed window's id can be handed out again, to a window of another class
+        if(DestroyNotify == xEvent.type)
+        {
+            forgetWindow(&cache, xEvent.xdestroywindow.window);
+        }
+
+        //every client hears about keymap changes; rebuild the key table from the new map
+        if(MappingNotify == xEvent.type && MappingPointer != xEvent.xmapping.request)
+        {
+            XRefreshKeyboardMapping(&xEvent.xmapping);
+            resolveBindings(focusDisplay);
+            logInfo("Keymap changed; bindings resolved again\n");
+        }
+    }
+    return NULL;
+}
+
+/*
+   gives the profile for a window, from the cache if it was focused recently.
+   Otherwise it is looked up with findProfile() and cached, replacing the oldest
+   entry, and the window is watched so its entry goes when it is destroyed.
+  
+   @param struct profileCache* cache the focus thread's cache
+   @param Display* focusDisplay the connection to ask on
+   @param Window window the focused window; None gives the default
+   @return const struct profile* the matching profile, or the default profile
+*/
+const struct profile* cachedProfile(struct profileCache* cache, Display* focusDisplay, Window window)
+{
+    if(None == window)
+    {
+        return &profiles[0];
+    }
+    if(DefaultRootWindow(focusDisplay) == window) //not cached; its event mask is PropertyChangeMask
+    {
+        return findProfile(focusDisplay, window);
+    }
+    for(int i = 0; i < PROFILE_CACHE_SIZE; i++)
+    {
+        if(window == cache->windows[i])
+        {
+            return cache->profiles[i];
+        }
+    }
+
+    const struct profile* profile = findProfile(focusDisplay, window);
+    if(None != cache->windows[cache->next])
+    {
+        XSelectInput(focusDisplay, cache->windows[cache->next], NoEventMask);
+    }
+    cache->windows[cache->next] = window;
+    cache->profiles[cache->next] = profile;
+    cache->next = (cache->next + 1) % PROFILE_CACHE_SIZE;
+    XSelectInput(focusDisplay, window, StructureNotifyMask); //for DestroyNotify
+    return profile;
+}
+
+/*
+   drops a window from the profile cache
+  
+   @param struct profileCache* cache the focus thread's cache
+   @param Window window the window that went away
+*/
+void forgetWindow(struct profileCache* cache, Window window)
+{
+    for(int i = 0; i < PROFILE_CACHE_SIZE; i++)
+    {
+        if(window == cache->windows[i])
+        {
+            cache->windows[i] = None;
+        }
+    }
+}
+
+/*
+   finds the profile for a window by its WM_CLASS class name
+  
+   @param Display* focusDisplay the connection to ask on
+   @param Window window the window to look up; None gives the default
+   @return const struct profile* the matching profile, or the default profile
+*/
+const struct profile* findProfile(Display* focusDisplay, Window window)
+{
+    const struct profile* match = &profiles[0];
+    XClassHint hint;
+    if(None != window && 0 != XGetClassHint(focusDisplay, window, &hint))
+    {
+        for(unsigned int i = 1; i < PROFILE_COUNT; i++)
+        {
+            if(NULL != hint.res_class && 0 == strcasecmp(profiles[i].windowClass, hint.res_class))
+            {
+                match = &profiles[i];
+                break;
+            }
+        }
+        XFree(hint.res_name);
+        XFree(hint.res_class);
+    }
+    return match;
+}
+
+/*
+   X error handler that logs instead of exiting; errors here are windows
+   that closed before they were looked up
+  
+   @param Display* errDisplay the connection the error came from
+   @param XErrorEvent* error the error
+   @return int ignored by Xlib
+*/
+int ignoreXError(Display* errDisplay, XErrorEvent* error)
+{
+    logDebug("ignored X error %d\n", error->error_code);
+    return 0;
+}
+#endif
+
+/*
+   opens a js device, or a regular file holding a recorded session
+  
+   @param struct inputSource* source the source to fill in
+   @param const char* path the device or recording
+   @return int 0 on success, else -1
+*/
+int openJsSource(struct inputSource* source, const char* path)
+{
+    memset(source, 0, sizeof(*source));
+    source->kind = "js";
+    source->listenFd = -1;
+    source->open = openJsSource;
+    source->readEvents = readJsEvents;
+    source->close = closeFdSource;
+
+//     source->fd = open(path, O_RDONLY); //blocking read: blocks program if nothing to read
+    source->fd = open(path, O_RDONLY | O_NONBLOCK); // nonblocking; just moves on if there's nothing to read
+    if(source->fd < 0)
+    {
+        return -1;
+    }
+
+    //a regular file is a recorded session; it gets played back once and then the program exits
+    struct stat devStat;
+    source->replay = (0 == fstat(source->fd, &devStat) && S_ISREG(devStat.st_mode));
+
+    unsigned char axisCount = DEFAULT_AXIS_COUNT; //JSIOCGAXES writes a single byte
+    ioctl(source->fd, JSIOCGAXES, &axisCount);
+    source->axisCount = axisCount;
+    return 0;
+}
+
+/*
+   reads events from a js device or recording.
+   The js driver hands over as many queued events as fit in one read().
+*/
+ssize_t readJsEvents(struct inputSource* source, struct js_event* batch, int max)
+{
+    if(source->replay)
+    {
+        max = 1; //a live device trickles events in, so replay them one per pass of the loop
+    }
+    ssize_t numRead = read(source->fd, batch, max * sizeof(struct js_event));
+    if(numRead < 0)
+    {
+        return -1;
+    }
+    if(0 == numRead && !source->replay) //a live device with nothing new
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+    return numRead / sizeof(struct js_event);
+}
+
+/*
+   opens an evdev device (/dev/input/event*) and records its axis ranges
+   and current values; the values are handed out as init events on the first read,
+   the way a js device announces its state when opened
+  
+   @param struct inputSource* source the source to fill in
+   @param const char* path the device
+   @return int 0 on success, else -1
+*/
+int openEvdevSource(struct inputSource* source, const char* path)
+{
+    memset(source, 0, sizeof(*source));
+    source->kind = "evdev";
+    source->listenFd = -1;
+    source->open = openEvdevSource;
+    source->axisCount = DEFAULT_AXIS_COUNT;
+    source->readEvents = readEvdevEvents;
+    source->close = closeFdSource;
+
+    source->fd = open(path, O_RDONLY | O_NONBLOCK);
+    if(source->fd < 0)
+    {
+        return -1;
+    }
+
+    const int codes[] = {ABS_X, ABS_Y, ABS_Z, ABS_RX, ABS_RY, ABS_RZ, ABS_HAT0X, ABS_HAT0Y};
+    for(int i = 0; i < DEFAULT_AXIS_COUNT; i++)
+    {
+        struct input_absinfo info;
+        int axis = evdevAxisNumber(codes[i]);
+        if(0 == ioctl(source->fd, EVIOCGABS(codes[i]), &info) && info.maximum > info.minimum)
+        {
+            source->absMin[axis] = info.minimum;
+            source->absMax[axis] = info.maximum;
+            source->absInit[axis] = info.value;
+        }
+        else //axis missing; pass values through unscaled
+        {
+            source->absMin[axis] = -STICK_MAX;
+            source->absMax[axis] = STICK_MAX;
+            source->absInit[axis] = 0;
+        }
+    }
+    source->initPending = true;
+    return 0;
+}
+
+/*
+   reads evdev events and translates them into js events:
+   axes are renumbered and rescaled to [-STICK_MAX, STICK_MAX] and
+   buttons are renumbered, both following the xpad js layout.
+   Anything else (sync, misc, autorepeat) is dropped.
+*/
+ssize_t readEvdevEvents(struct inputSource* source, struct js_event* batch, int max)
+{
+    if(source->initPending && max >= DEFAULT_AXIS_COUNT)
+    {
+        source->initPending = false;
+        for(int axis = 0; axis < DEFAULT_AXIS_COUNT; axis++)
+        {
+            long range = (long) source->absMax[axis] - source->absMin[axis];
+            batch[axis].type = JS_EVENT_AXIS | JS_EVENT_INIT;
+            batch[axis].number = axis;
+            batch[axis].value = (int) (((long) source->absInit[axis] - source->absMin[axis]) * (2 * STICK_MAX) / range - STICK_MAX);
+            batch[axis].time = 0;
+        }
+        return DEFAULT_AXIS_COUNT;
+    }
+
+    struct input_event raw[EVENT_BATCH];
+    if(max > EVENT_BATCH)
+    {
+        max = EVENT_BATCH;
+    }
+    ssize_t numRead = read(source->fd, raw, max * sizeof(struct input_event));
+    if(numRead < 0)
+    {
+        return -1;
+    }
+
+    ssize_t count = 0;
+    for(ssize_t i = 0; i < numRead / (ssize_t) sizeof(struct input_event); i++)
+    {
+        struct js_event* event = &batch[count];
+        int number = -1;
+        if(EV_ABS == raw[i].type && (number = evdevAxisNumber(raw[i].code)) >= 0)
+        {
+            long range = (long) source->absMax[number] - source->absMin[number];
+            event->type = JS_EVENT_AXIS;
+            event->value = (int) (((long) raw[i].value - source->absMin[number]) * (2 * STICK_MAX) / range - STICK_MAX);
+        }
+        else if(EV_KEY == raw[i].type && raw[i].value < 2 && (number = evdevButtonNumber(raw[i].code)) >= 0)
+        {
+            event->type = JS_EVENT_BUTTON;
+            event->value = raw[i].value;
+        }
+        else
+        {
+            continue;
+        }
+        event->number = number;
+        event->time = raw[i].input_event_sec * 1000 + raw[i].input_event_usec / 1000;
+        count++;
+    }
+    if(0 == count)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+    return count;
+}
+
+/*
+   @param int code an evdev ABS_* code
+   @return int the js axis number for code, or -1 if it has none
+*/
+int evdevAxisNumber(int code)
+{
+    switch(code)
+    {
+        case ABS_X:     return L_STICK_H;
+        case ABS_Y:     return L_STICK_V;
+        case ABS_Z:     return L_TRIGGER;
+        case ABS_RX:    return R_STICK_H;
+        case ABS_RY:    return R_STICK_V;
+        case ABS_RZ:    return R_TRIGGER;
+        case ABS_HAT0X: return D_PAD_H;
+        case ABS_HAT0Y: return D_PAD_V;
+        default:        return -1;
+    }
+}
+
+/*
+   @param int code an evdev BTN_* code
+   @return int the js button number for code, or -1 if it has none
+*/
+int evdevButtonNumber(int code)
+{
+    switch(code)
+    {
+        case BTN_A:      return A_BTN;
+        case BTN_B:      return B_BTN;
+        case BTN_X:      return X_BTN;
+        case BTN_Y:      return Y_BTN;
+        case BTN_TL:     return LB_BTN;
+        case BTN_TR:     return RB_BTN;
+        case BTN_SELECT: return BACK_BTN;
+        case BTN_START:  return START_BTN;
+        case BTN_MODE:   return XBOX_BTN;
+        default:         return -1;
+    }
+}
+
+/*
+   listens on a Unix stream socket for a virtual controller.
+   One client is served at a time; it writes struct js_event records back to back,
+   exactly as they would be read from a js device. When it disconnects the
+   source waits for the next one.
+  
+   @param struct inputSource* source the source to fill in
+   @param const char* path where to create the socket; a stale socket there is replaced
+   @return int 0 on success, else -1
+*/
+int openSocketSource(struct inputSource* source, const char* path)
+{
+    memset(source, 0, sizeof(*source));
+    source->kind = "socket";
+    source->fd = -1;
+    source->open = openSocketSource;
+    source->axisCount = DEFAULT_AXIS_COUNT;
+    source->readEvents = readSocketEvents;
+    source->close = closeSocketSource;
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(address.sun_path))
+    {
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    source->listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(source->listenFd < 0)
+    {
+        return -1;
+    }
+    unlink(path);
+    if(0 != bind(source->listenFd, (struct sockaddr*) &address, sizeof(address))
+       || 0 != listen(source->listenFd, 1))
+    {
+        close(source->listenFd);
+        source->listenFd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+   reads events from the connected virtual controller, accepting one if needed.
+   Bytes go straight from the socket into batch; only the tail of an event split
+   across reads (under one event's worth) is copied, through carry.
+   When the client hangs up, fails with errno set to ECONNRESET.
+*/
+ssize_t readSocketEvents(struct inputSource* source, struct js_event* batch, int max)
+{
+    if(source->fd < 0)
+    {
+        source->fd = accept4(source->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(source->fd < 0)
+        {
+            return -1;
+        }
+        logInfo("Virtual controller connected\n");
+        source->carryLen = 0;
+    }
+
+    char* bytes = (char*) batch;
+    memcpy(bytes, source->carry, source->carryLen);
+    ssize_t numRead = recv(source->fd, bytes + source->carryLen, max * sizeof(struct js_event) - source->carryLen, 0);
+    if(numRead <= 0)
+    {
+        if(0 == numRead || (EAGAIN != errno && EWOULDBLOCK != errno))
+        {
+            logInfo("Virtual controller disconnected\n");
+            close(source->fd);
+            source->fd = -1;
+            errno = ECONNRESET; //tells the loop to let go of what the client held
+        }
+        return -1;
+    }
+
+    size_t total = source->carryLen + numRead;
+    ssize_t count = total / sizeof(struct js_event);
+    source->carryLen = total % sizeof(struct js_event);
+    memcpy(source->carry, bytes + count * sizeof(struct js_event), source->carryLen);
+    if(0 == count)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+    return count;
+}
+
+/*
+   closes the socket source and removes its socket file
+*/
+void closeSocketSource(struct inputSource* source)
+{
+    struct sockaddr_un address;
+    socklen_t length = sizeof(address);
+    if(0 == getsockname(source->listenFd, (struct sockaddr*) &address, &length))
+    {
+        unlink(address.sun_path);
+    }
+    closeFdSource(source);
+}
+
+/*
+   closes whatever descriptors a source holds
+*/
+void closeFdSource(struct inputSource* source)
+{
+    if(source->fd >= 0)
+    {
+        close(source->fd);
+        source->fd = -1;
+    }
+    if(source->listenFd >= 0)
+    {
+        close(source->listenFd);
+        source->listenFd = -1;
+    }
+}
+
+/*
+   waits for a disconnected device node to come back, then reopens it.
+   Sleeps in read() on an inotify watch of the device's directory, so no CPU is
+   used while the device is gone; the node is retried whenever a file there is
+   created or has its permissions changed (udev does the latter after creating it).
+  
+   @param struct inputSource* source the closed source to reopen
+   @param const char* path the device node
+   @param long long* appearedMs set to when the node was first seen again (nowMs() time)
+   @return int 0 once reopened, -1 if the directory can't be watched
+*/
+int waitForDevice(struct inputSource* source, const char* path, long long* appearedMs)
+{
+    char dir[DEVICE_N_LEN];
+    strcpy(dir, path);
+    char* slash = strrchr(dir, '/');
+    const char* name = strrchr(path, '/') + 1;
+    *slash = '\0';
+
+    int watch = inotify_init1(IN_CLOEXEC);
+    if(watch < 0 || inotify_add_watch(watch, ('\0' == dir[0]) ? "/" : dir, IN_CREATE | IN_ATTRIB) < 0)
+    {
+        if(watch >= 0)
+        {
+            close(watch);
+        }
+        return -1;
+    }
+
+    *appearedMs = 0;
+    for(;;)
+    {
+        //try first, in case it came back before the watch was set up
+        if(0 == source->open(source, path))
+        {
+            if(0 == *appearedMs)
+            {
+                *appearedMs = nowMs();
+            }
+            close(watch);
+            return 0;
+        }
+
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t numRead = read(watch, buffer, sizeof(buffer));
+        if(numRead < 0 && EINTR != errno)
+        {
+            close(watch);
+            return -1;
+        }
+        for(char* at = buffer; at < buffer + numRead; )
+        {
+            struct inotify_event* change = (struct inotify_event*) at;
+            if(0 == *appearedMs && change->len > 0 && 0 == strcmp(change->name, name))
+            {
+                *appearedMs = nowMs();
+            }
+            at += sizeof(struct inotify_event) + change->len;
+        }
+    }
+}
+
+/*
+   @return long long a monotonic clock reading in milliseconds
+*/
+long long nowMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+#if MPX_BACKEND
+/*
+   creates a master pointer/keyboard pair named name and finds the XTEST
+   slave devices the server attaches to it, so this controller's motion, clicks
+   and keys reach only its own pointer and keyboard focus
+  
+   @param const char* name the name of the pair; the server adds " pointer"/" keyboard"
+   @return int 0 on success, else -1
+*/
+int mpxCreate(const char* name)
+{
+    int opcode, firstEvent, firstError;
+    int major = 2;
+    int minor = 0;
+    if(!XQueryExtension(display, "XInputExtension", &opcode, &firstEvent, &firstError)
+       || Success != XIQueryVersion(display, &major, &minor))
+    {
+        return -1;
+    }
+
+    XIAddMasterInfo add;
+    add.type = XIAddMaster;
+    add.name = (char*) name;
+    add.send_core = True;
+    add.enable = True;
+    if(Success != XIChangeHierarchy(display, (XIAnyHierarchyChangeInfo*) &add, 1))
+    {
+        return -1;
+    }
+    XSync(display, False);
+
+    char pointerName[DEVICE_N_LEN];
+    char keyboardName[DEVICE_N_LEN];
+    char fakePointerName[DEVICE_N_LEN];
+    char fakeKeyboardName[DEVICE_N_LEN];
+    snprintf(pointerName, DEVICE_N_LEN, "%s pointer", name);
+    snprintf(keyboardName, DEVICE_N_LEN, "%s keyboard", name);
+    snprintf(fakePointerName, DEVICE_N_LEN, "%s XTEST pointer", name);
+    snprintf(fakeKeyboardName, DEVICE_N_LEN, "%s XTEST keyboard", name);
+
+    int deviceCount = 0;
+    XIDeviceInfo* devices = XIQueryDevice(display, XIAllDevices, &deviceCount);
+    int masterKeyboard = 0;
+    int fakePointer = -1;
+    int fakeKeyboard = -1;
+    for(int i = 0; i < deviceCount; i++)
+    {
+        if(XIMasterPointer == devices[i].use && 0 == strcmp(devices[i].name, pointerName))
+        {
+            mpx.pointer = devices[i].deviceid;
+            mpx.keyboard = devices[i].attachment;
+        }
+        else if(XIMasterKeyboard == devices[i].use && 0 == strcmp(devices[i].name, keyboardName))
+        {
+            masterKeyboard = devices[i].deviceid;
+        }
+        else if(0 == strcmp(devices[i].name, fakePointerName))
+        {
+            fakePointer = devices[i].deviceid;
+        }
+        else if(0 == strcmp(devices[i].name, fakeKeyboardName))
+        {
+            fakeKeyboard = devices[i].deviceid;
+        }
+    }
+    XIFreeDeviceInfo(devices);
+
+    //from here on the pair exists, so every failure takes it down again
+    if(0 == mpx.pointer || fakePointer < 0 || fakeKeyboard < 0)
+    {
+        if(0 == mpx.pointer)
+        {
+            mpx.pointer = masterKeyboard; //removing either master of a pair removes both
+        }
+        mpxRemove();
+        return -1;
+    }
+    mpx.fakePointer = XOpenDevice(display, fakePointer);
+    mpx.fakeKeyboard = XOpenDevice(display, fakeKeyboard);
+    if(NULL == mpx.fakePointer || NULL == mpx.fakeKeyboard)
+    {
+        mpxRemove();
+        return -1;
+    }
+    mpx.active = true;
+    return 0;
+}
+
+/*
+   removes the master pair made by mpxCreate(); its slaves are left floating
+*/
+void mpxRemove(void)
+{
+    if(0 == mpx.pointer)
+    {
+        return;
+    }
+    if(NULL != mpx.fakePointer)
+    {
+        XCloseDevice(display, mpx.fakePointer);
+    }
+    if(NULL != mpx.fakeKeyboard)
+    {
+        XCloseDevice(display, mpx.fakeKeyboard);
+    }
+
+    XIRemoveMasterInfo remove;
+    remove.type = XIRemoveMaster;
+    remove.deviceid = mpx.pointer;
+    remove.return_mode = XIFloating;
+    XIChangeHierarchy(display, (XIAnyHierarchyChangeInfo*) &remove, 1);
+    XSync(display, False);
+    memset(&mpx, 0, sizeof(mpx));
+}
+#endif
+
+#if YDOTOOL_BACKEND
+/*
+   connects to ydotoold's datagram socket.
+   Also used to reconnect after the daemon restarts, with ydotool.address.sun_path as path.
+  
+   @param const char* path the socket path
+   @return int 0 on success, else -1
+ */
+int ydotoolConnect(const char* path)
+{
+    if(strlen(path) >= sizeof(ydotool.address.sun_path))
+    {
+        printf("Error: socket path [%s] is too long\n", path);
+        return -1;
+    }
+    if(ydotool.fd >= 0)
+    {
+        close(ydotool.fd);
+    }
+
+    ydotool.address.sun_family = AF_UNIX;
+    if(path != ydotool.address.sun_path) //a reconnect passes the stored path back in; strcpy() can't overlap
+    {
+        strcpy(ydotool.address.sun_path, path);
+    }
+    ydotool.fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if(ydotool.fd < 0)
+    {
+        return -1;
+    }
+    if(0 != connect(ydotool.fd, (struct sockaddr*) &ydotool.address, sizeof(ydotool.address)))
+    {
+        close(ydotool.fd);
+        ydotool.fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+   buffers one input event for ydotoold, sending the buffer first if it is full
+  
+   @param int type the event type, e.g. EV_REL
+   @param int code the event code, e.g. REL_X
+   @param int value the event value
+ */
+void ydotoolEmit(int type, int code, int value)
+{
+    if(YDOTOOL_BATCH == ydotool.count)
+    {
+        ydotoolFlush();
+    }
+    struct input_event* event = &ydotool.events[ydotool.count++];
+    memset(event, 0, sizeof(*event));
+    event->type = type;
+    event->code = code;
+    event->value = value;
+}
+
+/*
+   sends the buffered events to ydotoold, one datagram per event as the daemon
+   expects, but all in one sendmmsg() call.
+   If the daemon went away, reconnects once and retries; the batch is dropped
+   if that fails too, so a dead daemon can't stall the output thread.
+  
+   @return int 0 on success, else -1
+ */
+int ydotoolFlush(void)
+{
+    if(0 == ydotool.count)
+    {
+        return 0;
+    }
+
+    struct iovec parts[YDOTOOL_BATCH];
+    struct mmsghdr messages[YDOTOOL_BATCH];
+    memset(messages, 0, sizeof(messages));
+    for(int i = 0; i < ydotool.count; i++)
+    {
+        parts[i].iov_base = &ydotool.events[i];
+        parts[i].iov_len = sizeof(struct input_event);
+        messages[i].msg_hdr.msg_iov = &parts[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int sent = 0;
+    bool retried = false;
+    while(sent < ydotool.count)
+    {
+        int result = sendmmsg(ydotool.fd, messages + sent, ydotool.count - sent, 0);
+        if(result > 0)
+        {
+            sent += result;
+            ydotool.batches++;
+            continue;
+        }
+        if(result < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if(!retried && 0 == ydotoolConnect(ydotool.address.sun_path))
+        {
+            logWarn("Warning: reconnected to ydotoold\n");
+            retried = true;
+            continue;
+        }
+        logError("Error: ydotoold isn't taking events (%s); dropped %d\n", strerror(errno), ydotool.count - sent);
+        break;
+    }
+    int dropped = ydotool.count - sent;
+    ydotool.sent += sent;
+    ydotool.count = 0;
+    return (0 == dropped) ? 0 : -1;
+}
+
+//keysym names ydotoolKeycode() knows, with the evdev key code each one is on a US layout
+struct evdevKeyName
+{
+    const char* name;
+    int code;
+};
+
+const struct evdevKeyName evdevKeyNames[] =
+{
+    {"Control_L", KEY_LEFTCTRL}, {"Control_R", KEY_RIGHTCTRL}, {"Shift_L", KEY_LEFTSHIFT},
+    {"Shift_R", KEY_RIGHTSHIFT}, {"Alt_L", KEY_LEFTALT}, {"Alt_R", KEY_RIGHTALT},
+    {"Super_L", KEY_LEFTMETA}, {"Super_R", KEY_RIGHTMETA},
+    {"Up", KEY_UP}, {"Down", KEY_DOWN}, {"Left", KEY_LEFT}, {"Right", KEY_RIGHT},
+    {"Page_Up", KEY_PAGEUP}, {"Prior", KEY_PAGEUP}, {"Page_Down", KEY_PAGEDOWN}, {"Next", KEY_PAGEDOWN},
+    {"Home", KEY_HOME}, {"End", KEY_END}, {"Insert", KEY_INSERT}, {"Delete", KEY_DELETE},
+    {"Return", KEY_ENTER}, {"Escape", KEY_ESC}, {"Tab", KEY_TAB}, {"BackSpace", KEY_BACKSPACE},
+    {"space", KEY_SPACE}, {"minus", KEY_MINUS}, {"equal", KEY_EQUAL}, {"plus", KEY_KPPLUS},
+    {"F1", KEY_F1}, {"F2", KEY_F2}, {"F3", KEY_F3}, {"F4", KEY_F4}, {"F5", KEY_F5}, {"F6", KEY_F6},
+    {"F7", KEY_F7}, {"F8", KEY_F8}, {"F9", KEY_F9}, {"F10", KEY_F10}, {"F11", KEY_F11}, {"F12", KEY_F12},
+    {"a", KEY_A}, {"b", KEY_B}, {"c", KEY_C}, {"d", KEY_D}, {"e", KEY_E}, {"f", KEY_F}, {"g", KEY_G},
+    {"h", KEY_H}, {"i", KEY_I}, {"j", KEY_J}, {"k", KEY_K}, {"l", KEY_L}, {"m", KEY_M}, {"n", KEY_N},
+    {"o", KEY_O}, {"p", KEY_P}, {"q", KEY_Q}, {"r", KEY_R}, {"s", KEY_S}, {"t", KEY_T}, {"u", KEY_U},
+    {"v", KEY_V}, {"w", KEY_W}, {"x", KEY_X}, {"y", KEY_Y}, {"z", KEY_Z},
+    {"0", KEY_0}, {"1", KEY_1}, {"2", KEY_2}, {"3", KEY_3}, {"4", KEY_4},
+    {"5", KEY_5}, {"6", KEY_6}, {"7", KEY_7}, {"8", KEY_8}, {"9", KEY_9},
+};
+#define EVDEV_KEY_NAME_COUNT (sizeof(evdevKeyNames) / sizeof(evdevKeyNames[0]))
+
+/*
+   looks up the evdev key code for a keysym name.
+   uinput sits below the keymap, so there is no server to ask; this assumes a US layout,
+   as ydotool itself does. Letters match either case.
+  
+   @param const char* keysymName the keysym name, e.g. "Page_Up"
+   @return int the key code, or 0 if the name isn't in evdevKeyNames[]
+ */
+int ydotoolKeycode(const char* keysymName)
+{
+    for(unsigned int i = 0; i < EVDEV_KEY_NAME_COUNT; i++)
+    {
+        const char* name = evdevKeyNames[i].name;
+        if(0 == strcmp(name, keysymName)
+           || ('\0' == name[1] && '\0' == keysymName[1] && name[0] == (keysymName[0] | 0x20)))
+        {
+            return evdevKeyNames[i].code;
+        }
+    }
+    return 0;
+}
+#endif
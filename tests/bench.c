@@ -0,0 +1,108 @@
+/*
+   usage: make bench
+
+   Description:
+   times the per-event transforms the event loop runs and prints ns/op for each,
+   so a change to one of them can be checked for cost. Every call sweeps the
+   int16 axis range; the results are summed into a volatile so nothing is optimized away.
+*/
+
+//pull in js2mouse itself, keeping its main() out of the way
+#define main js2mouseMain
+#include "../js2mouse.c"
+#undef main
+
+#define AXIS_MIN -32768
+#define AXIS_MAX 32767
+#define BENCH_ROUNDS 200 //sweeps of the axis range per transform
+
+volatile long sink = 0;
+
+double elapsedNs(const struct timespec* start, const struct timespec* end);
+void report(const char* name, const struct timespec* start, const struct timespec* end);
+
+int main(void)
+{
+    struct timespec start;
+    struct timespec end;
+    long sum = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for(int value = AXIS_MIN; value <= AXIS_MAX; value++)
+        {
+            sum += dpadDirection(value, D_PAD_DEADZ);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sink += sum;
+    report("dpadDirection", &start, &end);
+
+    sum = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for(int value = AXIS_MIN; value <= AXIS_MAX; value++)
+        {
+            sum += stickNudge(value, R_STICK_DEADZ, NUDGE_DIVISOR);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sink += sum;
+    report("stickNudge", &start, &end);
+
+    sum = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for(int value = AXIS_MIN; value <= AXIS_MAX; value++)
+        {
+            sum += stickTarget(value, ABS_REGION_X, ABS_REGION_W);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sink += sum;
+    report("stickTarget", &start, &end);
+
+    //the filter keeps state, so it gets one filter per round and a time that moves on
+    float filtered = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        struct oneEuro filter = {0};
+        unsigned int time = 0;
+        for(int value = AXIS_MIN; value <= AXIS_MAX; value++)
+        {
+            filtered += oneEuroFilter(&filter, value, time++, FILTER_MIN_CUTOFF, FILTER_BETA);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sink += (long) filtered;
+    report("oneEuroFilter", &start, &end);
+
+    return 0;
+}
+
+/*
+   @param const struct timespec* start when timing started
+   @param const struct timespec* end when timing stopped
+   @return double the nanoseconds in between
+ */
+double elapsedNs(const struct timespec* start, const struct timespec* end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+/*
+   prints one line of results
+
+   @param const char* name the transform timed
+   @param const struct timespec* start when timing started
+   @param const struct timespec* end when timing stopped
+ */
+void report(const char* name, const struct timespec* start, const struct timespec* end)
+{
+    long ops = (long) BENCH_ROUNDS * (AXIS_MAX - AXIS_MIN + 1);
+    printf("%-14s %8.2f ns/op (%ld ops)\n", name, elapsedNs(start, end) / ops, ops);
+}
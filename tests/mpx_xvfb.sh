@@ -0,0 +1,84 @@
+#!/bin/sh
+#
+#   usage: make test-mpx
+#
+#   Description:
+#   runs the MPX backend (argument M) against a headless Xvfb server and checks
+#   with `xinput list` that js2mouse adds its master pointer/keyboard pair while it
+#   runs and removes it again once it quits. The controller is a socket source fed
+#   by python3: one stick deflection, then XBOX to quit.
+#   Needs Xvfb, xinput, python3 and the X11, Xi and Xtst development libraries.
+#   Exits non-zero if a check fails.
+
+DISPLAY_NUM=${MPX_DISPLAY:-:99}
+WORK=$(mktemp -d)
+PAD="$WORK/pad"
+NAME="js2mouse pad" #the pair is named after the last part of the socket path
+failed=0
+
+cleanup()
+{
+    [ -n "$JS2MOUSE" ] && kill "$JS2MOUSE" 2>/dev/null
+    [ -n "$XVFB" ] && kill "$XVFB" 2>/dev/null
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+check()
+{
+    if eval "$2"; then
+        echo "ok: $1"
+    else
+        echo "FAILED: $1"
+        failed=1
+    fi
+}
+
+gcc -Wall -pthread -DX11_BACKEND=1 -DMPX_BACKEND=1 -o "$WORK/js2mouse" js2mouse.c -lX11 -lXi -lXtst || exit 1
+
+Xvfb "$DISPLAY_NUM" -nolisten tcp >"$WORK/xvfb.log" 2>&1 &
+XVFB=$!
+export DISPLAY="$DISPLAY_NUM"
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    xinput list >/dev/null 2>&1 && break
+    sleep 0.2
+done
+
+"$WORK/js2mouse" "unix:$PAD" M >"$WORK/js2mouse.log" 2>&1 &
+JS2MOUSE=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    [ -S "$PAD" ] && break
+    sleep 0.2
+done
+
+check "master pointer added" "xinput list --name-only | grep -qx '$NAME pointer'"
+check "master keyboard added" "xinput list --name-only | grep -qx '$NAME keyboard'"
+check "XTEST slaves added" "xinput list --name-only | grep -qx '$NAME XTEST pointer'"
+
+#struct js_event: time, value, type, number
+python3 - "$PAD" <<'EOF'
+import socket, struct, sys, time
+pad = socket.socket(socket.AF_UNIX)
+pad.connect(sys.argv[1])
+now = lambda: int(time.monotonic() * 1000) & 0xffffffff
+pad.send(struct.pack('IhBB', now(), 20000, 2, 3)) #right stick right
+time.sleep(0.3)
+pad.send(struct.pack('IhBB', now(), 0, 2, 3))
+pad.send(struct.pack('IhBB', now(), 1, 1, 8)) #XBOX taps quit
+pad.send(struct.pack('IhBB', now(), 0, 1, 8))
+time.sleep(1)
+EOF
+
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    kill -0 "$JS2MOUSE" 2>/dev/null || break
+    sleep 0.2
+done
+check "js2mouse quit" "! kill -0 $JS2MOUSE 2>/dev/null"
+JS2MOUSE=
+check "master pair removed" "! xinput list --name-only | grep -q '^$NAME'"
+
+if [ 0 != "$failed" ]; then
+    cat "$WORK/js2mouse.log"
+    exit 1
+fi
+echo "The MPX pair comes and goes with js2mouse"
@@ -0,0 +1,259 @@
+/*
+   usage: make test
+
+   Description:
+   checks the contracts the doc comments of the pure stick and D-pad transforms
+   promise, over every value an int16 axis can report:
+    dpadDirection(): 0 inside the deadzone, the sign of value outside it, monotonic, odd-symmetric
+    stickNudge(): 0 strictly inside the deadzone, monotonic, odd-symmetric, and nonzero
+                  outside it wherever the deflection is worth a subpixel, whatever the divisor
+    stickTarget(): inside the span, monotonic, edges at +-STICK_MAX, mirrored to within a pixel
+   and the return codes of the handlers the event loop calls with them:
+    handleStick()/handleStickAbs(): -1 for an axis the device doesn't have, 0 at rest, 1 while nudging
+    handleDpadH()/handleDpadV(): 0 while a key is held, -1 once released
+   Prints every broken property and exits non-zero if there was one.
+*/
+
+//pull in js2mouse itself, keeping its main() out of the way
+#define main js2mouseMain
+#include "../js2mouse.c"
+#undef main
+
+#define AXIS_MIN -32768
+#define AXIS_MAX 32767
+#define MAX_REPORTS 10 //failures printed per check before the rest are only counted
+
+int failures = 0;
+
+//reports a broken property; only the first few of each check are printed
+#define CHECK(condition, count, ...) \
+    do { if(!(condition)) { if((count)++ < MAX_REPORTS) printf(__VA_ARGS__); failures++; } } while(0)
+
+int sign(int value);
+void checkDpadDirection(int deadZone);
+void checkStickNudge(int deadZone, int divisor);
+void checkStickTarget(int origin, int size);
+void checkHandlers(void);
+struct outputCommand* queueTail(void);
+
+int main(void)
+{
+    const int deadZones[] = {0, D_PAD_DEADZ, R_STICK_DEADZ, L_STICK_DEADZ, FLICK_DEADZ};
+    for(unsigned int i = 0; i < sizeof(deadZones) / sizeof(deadZones[0]); i++)
+    {
+        checkDpadDirection(deadZones[i]);
+        for(unsigned int p = 0; p < PROFILE_COUNT; p++)
+        {
+            checkStickNudge(deadZones[i], profiles[p].nudgeDivisor);
+        }
+        checkStickNudge(deadZones[i], 1);
+    }
+
+    checkStickTarget(ABS_REGION_X, ABS_REGION_W);
+    checkStickTarget(ABS_REGION_Y, ABS_REGION_H);
+    checkStickTarget(0, 1);
+    checkStickTarget(-500, 3841);
+
+    checkHandlers();
+
+    if(0 != failures)
+    {
+        printf("FAILED: %d broken properties\n", failures);
+        return 1;
+    }
+    printf("All transform properties hold\n");
+    return 0;
+}
+
+/*
+   @param int value any number
+   @return int 1, 0 or -1: the sign of value
+ */
+int sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+/*
+   checks dpadDirection() over the whole axis range
+
+   @param int deadZone the deadzone to check with
+ */
+void checkDpadDirection(int deadZone)
+{
+    int count = 0;
+    int last = dpadDirection(AXIS_MIN, deadZone);
+    for(int value = AXIS_MIN; value <= AXIS_MAX; value++)
+    {
+        int direction = dpadDirection(value, deadZone);
+        int expected = (value >= -deadZone && value <= deadZone) ? 0 : sign(value);
+        CHECK(direction == expected, count, "dpadDirection(%d, %d) is %d, expected %d\n",
+              value, deadZone, direction, expected);
+        CHECK(direction >= last, count, "dpadDirection(%d, %d) decreased\n", value, deadZone);
+        if(value > AXIS_MIN)
+        {
+            CHECK(dpadDirection(-value, deadZone) == -direction, count,
+                  "dpadDirection(%d, %d) isn't odd-symmetric\n", value, deadZone);
+        }
+        last = direction;
+    }
+}
+
+/*
+   checks stickNudge() over the whole axis range
+
+   @param int deadZone the deadzone to check with
+   @param int divisor the divisor to check with
+ */
+void checkStickNudge(int deadZone, int divisor)
+{
+    int count = 0;
+    int last = stickNudge(AXIS_MIN, deadZone, divisor);
+    for(int value = AXIS_MIN; value <= AXIS_MAX; value++)
+    {
+        int nudge = stickNudge(value, deadZone, divisor);
+        if(value > -deadZone && value < deadZone)
+        {
+            CHECK(0 == nudge, count, "stickNudge(%d, %d, %d) is %d inside the deadzone\n",
+                  value, deadZone, divisor, nudge);
+        }
+        else if((long) abs(value) * NUDGE_SUBPIXELS >= divisor)
+        {
+            CHECK(0 != nudge, count, "stickNudge(%d, %d, %d) is 0 outside the deadzone\n",
+                  value, deadZone, divisor);
+        }
+        CHECK(0 == nudge || sign(nudge) == sign(value), count,
+              "stickNudge(%d, %d, %d) is %d, the wrong way\n", value, deadZone, divisor, nudge);
+        CHECK(nudge >= last, count, "stickNudge(%d, %d, %d) decreased\n", value, deadZone, divisor);
+        if(value > AXIS_MIN)
+        {
+            CHECK(stickNudge(-value, deadZone, divisor) == -nudge, count,
+                  "stickNudge(%d, %d, %d) isn't odd-symmetric\n", value, deadZone, divisor);
+        }
+        last = nudge;
+    }
+}
+
+/*
+   checks stickTarget() over the whole axis range
+
+   @param int origin the first coordinate of the span
+   @param int size the number of pixels in the span
+ */
+void checkStickTarget(int origin, int size)
+{
+    int count = 0;
+    int last = stickTarget(AXIS_MIN, origin, size);
+    CHECK(origin == stickTarget(-STICK_MAX, origin, size), count,
+          "stickTarget(-STICK_MAX, %d, %d) isn't the first pixel\n", origin, size);
+    CHECK(origin == last, count, "stickTarget(%d, %d, %d) isn't clamped\n", AXIS_MIN, origin, size);
+    CHECK(origin + size - 1 == stickTarget(STICK_MAX, origin, size), count,
+          "stickTarget(STICK_MAX, %d, %d) isn't the last pixel\n", origin, size);
+    for(int value = AXIS_MIN; value <= AXIS_MAX; value++)
+    {
+        int target = stickTarget(value, origin, size);
+        CHECK(target >= origin && target < origin + size, count,
+              "stickTarget(%d, %d, %d) is %d, outside the span\n", value, origin, size, target);
+        CHECK(target >= last, count, "stickTarget(%d, %d, %d) decreased\n", value, origin, size);
+        if(value > AXIS_MIN)
+        {
+            //truncation can put a mirrored pair one pixel closer together, never further apart
+            int mirror = stickTarget(-value, origin, size);
+            int span = (target - origin) + (mirror - origin);
+            CHECK(span == size - 1 || span == size - 2, count,
+                  "stickTarget(%d, %d, %d) doesn't mirror stickTarget(%d)\n", value, origin, size, -value);
+        }
+        last = target;
+    }
+}
+
+/*
+   @return struct outputCommand* the newest command waiting in the output queue
+ */
+struct outputCommand* queueTail(void)
+{
+    return &outputQueue.commands[(outputQueue.head + outputQueue.count - 1) % OUTPUT_QUEUE_SIZE];
+}
+
+/*
+   checks the return codes of the stick and D-pad handlers.
+   The output queue is marked running without starting its thread, so nothing is
+   injected: what the handlers send waits in the queue to be looked at, then is dropped.
+ */
+void checkHandlers(void)
+{
+    int count = 0;
+    int axes[2] = {0, 0};
+    const struct profile* profile = &profiles[0];
+    outputQueue.running = true;
+
+    CHECK(-1 == handleStick(axes, 2, 2, 1, R_STICK_DEADZ, NUDGE_DIVISOR), count,
+          "handleStick() took a horizontal axis past the end\n");
+    CHECK(-1 == handleStick(axes, 2, 0, 2, R_STICK_DEADZ, NUDGE_DIVISOR), count,
+          "handleStick() took a vertical axis past the end\n");
+    CHECK(-1 == handleStickAbs(axes, 2, 2, 1, R_STICK_DEADZ, FLICK_DEADZ, NUDGE_DIVISOR), count,
+          "handleStickAbs() took an axis past the end\n");
+
+    axes[0] = R_STICK_DEADZ - 1;
+    axes[1] = 1 - R_STICK_DEADZ;
+    CHECK(0 == handleStick(axes, 2, 0, 1, R_STICK_DEADZ, NUDGE_DIVISOR), count,
+          "handleStick() isn't at rest inside the deadzone\n");
+    CHECK(0 == outputQueue.count, count, "handleStick() moved the cursor inside the deadzone\n");
+
+    axes[0] = STICK_MAX;
+    axes[1] = 0;
+    CHECK(1 == handleStick(axes, 2, 0, 1, R_STICK_DEADZ, NUDGE_DIVISOR), count,
+          "handleStick() isn't nudging at full deflection\n");
+    CHECK(1 == outputQueue.count && OUTPUT_REL == queueTail()->kind && queueTail()->a > 0, count,
+          "handleStick() didn't move the cursor right at full deflection\n");
+    outputQueue.count = 0;
+
+    //a deflection just past the deadzone on the slowest profile moves less than a pixel per call,
+    //but still nudges every time and adds up to whole pixels
+    int divisor = NUDGE_DIVISOR;
+    for(unsigned int p = 0; p < PROFILE_COUNT; p++)
+    {
+        divisor = (profiles[p].nudgeDivisor > divisor) ? profiles[p].nudgeDivisor : divisor;
+    }
+    axes[0] = 0;
+    handleStick(axes, 2, 0, 1, R_STICK_DEADZ, divisor); //at rest, so nothing is carried over
+    axes[0] = R_STICK_DEADZ;
+    const int calls = 4 * NUDGE_SUBPIXELS;
+    int nudging = 0;
+    for(int i = 0; i < calls; i++)
+    {
+        nudging += handleStick(axes, 2, 0, 1, R_STICK_DEADZ, divisor);
+    }
+    int expected = calls * stickNudge(R_STICK_DEADZ, R_STICK_DEADZ, divisor) / NUDGE_SUBPIXELS;
+    CHECK(calls == nudging, count, "handleStick() was at rest %d of %d calls past the deadzone\n",
+          calls - nudging, calls);
+    CHECK(expected > 0 && 1 == outputQueue.count && expected == queueTail()->a, count,
+          "handleStick() moved %d pixels in %d calls past the deadzone, expected %d\n",
+          (0 == outputQueue.count) ? 0 : queueTail()->a, calls, expected);
+    outputQueue.count = 0;
+
+    axes[0] = 0;
+    CHECK(0 == handleStickAbs(axes, 2, 0, 1, R_STICK_DEADZ, FLICK_DEADZ, NUDGE_DIVISOR), count,
+          "handleStickAbs() isn't at rest with the stick centered\n");
+    axes[0] = STICK_MAX;
+    CHECK(1 == handleStickAbs(axes, 2, 0, 1, R_STICK_DEADZ, FLICK_DEADZ, NUDGE_DIVISOR), count,
+          "handleStickAbs() didn't place the cursor on a flick\n");
+    CHECK(0 == handleStickAbs(axes, 2, 0, 1, R_STICK_DEADZ, FLICK_DEADZ, NUDGE_DIVISOR), count,
+          "handleStickAbs() placed the cursor on the same target twice\n");
+    outputQueue.count = 0;
+
+    int (*const dpads[])(int, const struct profile*) = {handleDpadH, handleDpadV};
+    for(int d = 0; d < 2; d++)
+    {
+        CHECK(-1 == dpads[d](0, profile), count, "D-pad %d holds a key when centered\n", d);
+        CHECK(-1 == dpads[d](D_PAD_DEADZ, profile), count, "D-pad %d holds a key inside the deadzone\n", d);
+        CHECK(0 == dpads[d](STICK_MAX, profile), count, "D-pad %d holds nothing when pressed\n", d);
+        CHECK(0 == dpads[d](-STICK_MAX, profile), count, "D-pad %d holds nothing when pressed the other way\n", d);
+        CHECK(-1 == dpads[d](0, profile), count, "D-pad %d still holds a key after release\n", d);
+        CHECK(3 == outputQueue.count, count, "D-pad %d sent %d key changes for press, swap and release\n",
+              d, outputQueue.count);
+        outputQueue.count = 0;
+    }
+
+    outputQueue.running = false;
+}